@@ -0,0 +1,153 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace vintage::bench
+{
+
+// Prevents the compiler from optimizing away a computation whose result is
+// never used
+template <typename T>
+inline void do_not_optimize(const T& value) noexcept
+{
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  const volatile T sink = value;
+  (void)sink;
+#endif
+}
+
+struct result
+{
+  std::string name;
+  double ns_per_item{};
+  int64_t items_per_call{};
+  int64_t calls{};
+};
+
+struct reporter
+{
+  // Runs func repeatedly for about `min_time` and records the best time per
+  // item out of a few repetitions. func is expected to process
+  // `items_per_call` items (e.g. samples) at each call.
+  template <typename F>
+  const result& run(std::string name, int64_t items_per_call, F&& func)
+  {
+    return run(
+        std::move(name), items_per_call, int64_t(1) << 62, func, [] { });
+  }
+
+  // Same, but calls `between` after every `batch` calls of func, outside of
+  // the timing, e.g. to drain a queue which func fills
+  template <typename F, typename G>
+  const result& run(
+      std::string name,
+      int64_t items_per_call,
+      int64_t batch,
+      F&& func,
+      G&& between)
+  {
+    using clock = std::chrono::steady_clock;
+    using namespace std::chrono_literals;
+    static constexpr auto min_time = 50ms;
+    static constexpr int repetitions = 5;
+
+    auto measure = [&](int64_t calls)
+    {
+      std::chrono::duration<double, std::nano> elapsed{};
+      for (int64_t done = 0; done < calls;)
+      {
+        const int64_t n = std::min(batch, calls - done);
+        const auto t0 = clock::now();
+        for (int64_t i = 0; i < n; i++)
+          func();
+        elapsed += clock::now() - t0;
+        done += n;
+        between();
+      }
+      return elapsed;
+    };
+
+    // Warm-up and calibration of the number of calls
+    int64_t calls = 1;
+    while (measure(calls) < min_time / 4 && calls < (int64_t(1) << 30))
+      calls *= 2;
+
+    double best = 1e300;
+    for (int r = 0; r < repetitions; r++)
+      best = std::min(
+          best, measure(calls).count() / double(calls * items_per_call));
+
+    results.push_back(
+        {.name = std::move(name),
+         .ns_per_item = best,
+         .items_per_call = items_per_call,
+         .calls = calls});
+    return results.back();
+  }
+
+  std::vector<result> results;
+};
+
+// Machine-readable results, for tracking them over time
+inline void write_json(std::FILE* out, const std::vector<result>& results)
+{
+  std::fprintf(out, "{\n  \"context\": {\n");
+#if defined(__VERSION__)
+  std::fprintf(out, "    \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+  std::fprintf(out, "    \"unit\": \"ns/item\"\n  },\n  \"benchmarks\": [");
+  for (std::size_t i = 0; i < results.size(); i++)
+  {
+    const result& r = results[i];
+    std::fprintf(out, "%s\n    {\"name\": \"", i == 0 ? "" : ",");
+    for (char c : r.name)
+    {
+      if (c == '"' || c == '\\')
+        std::fputc('\\', out);
+      std::fputc(c, out);
+    }
+    std::fprintf(
+        out,
+        "\", \"ns_per_item\": %.6g, \"items_per_call\": %lld, "
+        "\"calls\": %lld}",
+        r.ns_per_item,
+        (long long)r.items_per_call,
+        (long long)r.calls);
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+}
+
+using suite = void (*)(reporter&);
+
+struct suite_entry
+{
+  const char* name{};
+  suite function{};
+};
+
+inline std::vector<suite_entry>& suites()
+{
+  static std::vector<suite_entry> s;
+  return s;
+}
+
+// Registers a benchmark suite at static-initialization time:
+//   static vintage::bench::register_suite r{"my_suite", my_suite};
+struct register_suite
+{
+  register_suite(const char* name, suite function)
+  {
+    suites().push_back({name, function});
+  }
+};
+
+}
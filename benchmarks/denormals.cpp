@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+// Measures the cost of a filter whose state decays into denormal numbers,
+// with and without the denormal_scope set by the wrappers around process.
+
+#include "benchmark.hpp"
+
+#include <vintage/denormals.hpp>
+
+namespace
+{
+// One-pole lowpass fed with silence: the tail of a filter or an envelope
+template <typename T>
+void decay(T* out, int32_t frames, T& state) noexcept
+{
+  for (int32_t i = 0; i < frames; i++)
+  {
+    state *= T(0.9999);
+    out[i] = state;
+  }
+}
+
+template <typename T>
+void compare(vintage::bench::reporter& r, const char* type)
+{
+  static constexpr int32_t frames = 512;
+  T out[frames];
+
+  // Starts in the denormal range and stays there for the whole block
+  const T start = sizeof(T) == 4 ? T(1e-39) : T(1e-309);
+
+  r.run(
+      std::string{"denormals/"} + type + "/default",
+      frames,
+      [&]
+      {
+        T state = start;
+        decay(out, frames, state);
+        vintage::bench::do_not_optimize(out[0]);
+      });
+
+  r.run(
+      std::string{"denormals/"} + type + "/flushed",
+      frames,
+      [&]
+      {
+        vintage::denormal_scope scope;
+        T state = start;
+        decay(out, frames, state);
+        vintage::bench::do_not_optimize(out[0]);
+      });
+}
+
+void denormals(vintage::bench::reporter& r)
+{
+  compare<float>(r, "float");
+  compare<double>(r, "double");
+}
+
+const vintage::bench::register_suite registered{"denormals", denormals};
+}
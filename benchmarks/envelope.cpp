@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+// Compares an envelope evaluated per sample from the elapsed time, as the
+// examples used to do, with the block-rate dsp::envelope.
+
+#include "benchmark.hpp"
+
+#include <vintage/dsp/envelope.hpp>
+
+#include <cmath>
+
+namespace
+{
+void envelope(vintage::bench::reporter& r)
+{
+  static constexpr int32_t frames = 512;
+  static constexpr int32_t voices = 16;
+  static constexpr float attack = 2000.f, release = 20000.f;
+  float gains[frames];
+
+  // Half the voices are released
+  int32_t elapsed[voices];
+  float sustain[voices];
+  for (int32_t v = 0; v < voices; v++)
+  {
+    elapsed[v] = 1000 * v;
+    sustain[v] = v % 2 ? INFINITY : 1000.f * v;
+  }
+
+  r.run(
+      "envelope/per_sample",
+      voices * frames,
+      [&]
+      {
+        for (int32_t v = 0; v < voices; v++)
+        {
+          for (int32_t i = 0; i < frames; i++)
+          {
+            const float t = float(elapsed[v] + i);
+            gains[i] = t < attack      ? t / attack
+                       : t < sustain[v] ? 1.f
+                                        : std::max(
+                                            0.f,
+                                            1.f - (t - sustain[v]) / release);
+          }
+          vintage::bench::do_not_optimize(gains[0]);
+        }
+      });
+
+  vintage::dsp::envelope env[voices];
+  for (int32_t v = 0; v < voices; v++)
+  {
+    env[v].attack = attack;
+    env[v].release = release;
+  }
+
+  r.run(
+      "envelope/block",
+      voices * frames,
+      [&]
+      {
+        for (int32_t v = 0; v < voices; v++)
+        {
+          // Keeps the voices cycling through all the segments
+          if (env[v].recycle()
+              || env[v].state() == vintage::dsp::envelope::stage::idle)
+            env[v].start();
+          else if (env[v].state() == vintage::dsp::envelope::stage::sustain)
+            env[v].stop();
+
+          env[v].process(gains, frames);
+          vintage::bench::do_not_optimize(gains[0]);
+        }
+      });
+}
+
+const vintage::bench::register_suite registered{"envelope", envelope};
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+// Compares the approximations of vintage/dsp/fast_math.hpp with libm
+
+#include "benchmark.hpp"
+
+#include <vintage/dsp/fast_math.hpp>
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+template <typename T, typename F>
+void run_over(
+    vintage::bench::reporter& r,
+    const std::string& name,
+    T lo,
+    T hi,
+    F func)
+{
+  static constexpr int32_t count = 4096;
+  std::vector<T> in(count), out(count);
+  std::mt19937 rng{1234};
+  std::uniform_real_distribution<T> dist{lo, hi};
+  for (auto& x : in)
+    x = dist(rng);
+
+  r.run(
+      name + (sizeof(T) == 4 ? "/float" : "/double"),
+      count,
+      [&]
+      {
+        for (int32_t i = 0; i < count; i++)
+          out[i] = func(in[i]);
+        vintage::bench::do_not_optimize(out[0]);
+      });
+}
+
+template <typename T>
+void compare(vintage::bench::reporter& r)
+{
+  using namespace vintage::dsp;
+  constexpr T pi = 3.141592653589793238462643383279502884;
+
+  // clang-format off
+  run_over<T>(r, "fast_math/tanh/libm", -5, 5, [](T x) { return std::tanh(x); });
+  run_over<T>(r, "fast_math/tanh/fast", -5, 5, [](T x) { return fast_tanh(x); });
+  run_over<T>(r, "fast_math/sin/libm", -pi, pi, [](T x) { return std::sin(x); });
+  run_over<T>(r, "fast_math/sin/fast", -pi, pi, [](T x) { return fast_sin(x); });
+  run_over<T>(r, "fast_math/cos/libm", -pi, pi, [](T x) { return std::cos(x); });
+  run_over<T>(r, "fast_math/cos/fast", -pi, pi, [](T x) { return fast_cos(x); });
+  run_over<T>(r, "fast_math/exp2/libm", -10, 10, [](T x) { return std::exp2(x); });
+  run_over<T>(r, "fast_math/exp2/fast", -10, 10, [](T x) { return fast_exp2(x); });
+  run_over<T>(r, "fast_math/log2/libm", 1e-3, 1e3, [](T x) { return std::log2(x); });
+  run_over<T>(r, "fast_math/log2/fast", 1e-3, 1e3, [](T x) { return fast_log2(x); });
+  run_over<T>(r, "fast_math/pitch/libm", 0, 127, [](T n) { return T(440) * std::pow(T(2), (n - T(69)) / T(12)); });
+  run_over<T>(r, "fast_math/pitch/fast", 0, 127, [](T n) { return fast_note_to_frequency(n); });
+  // clang-format on
+}
+
+void fast_math(vintage::bench::reporter& r)
+{
+  compare<float>(r);
+  compare<double>(r);
+}
+
+const vintage::bench::register_suite registered{"fast_math", fast_math};
+}
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "benchmark.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+// Usage: vintage_benchmarks [--json <file>] [suite-name-filter]
+//
+// With --json, the results are also written to <file>, or to the standard
+// output if it is "-".
+int main(int argc, char** argv)
+{
+  const char* filter = "";
+  const char* json = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+      json = argv[++i];
+    else
+      filter = argv[i];
+  }
+
+  vintage::bench::reporter reporter;
+  for (const auto& suite : vintage::bench::suites())
+  {
+    if (std::strstr(suite.name, filter))
+      suite.function(reporter);
+  }
+
+  if (json && std::strcmp(json, "-") == 0)
+  {
+    vintage::bench::write_json(stdout, reporter.results);
+    return 0;
+  }
+
+  std::printf("%-48s %12s %14s\n", "benchmark", "ns/item", "Mitems/s");
+  for (const auto& r : reporter.results)
+  {
+    std::printf(
+        "%-48s %12.3f %14.2f\n",
+        r.name.c_str(),
+        r.ns_per_item,
+        1e3 / r.ns_per_item);
+  }
+
+  if (json)
+  {
+    std::FILE* out = std::fopen(json, "w");
+    if (!out)
+    {
+      std::fprintf(stderr, "cannot write %s\n", json);
+      return 1;
+    }
+    vintage::bench::write_json(out, reporter.results);
+    std::fclose(out);
+  }
+}
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+// Compares the scalar and SIMD drivers of per-sample processors
+// on the example plug-ins.
+
+#include "../examples/audio_effect/distortion.hpp"
+#include "../examples/audio_effect/utility.hpp"
+#include "benchmark.hpp"
+
+#include <random>
+
+namespace
+{
+template <typename sample_t, typename T>
+void compare_drivers(vintage::bench::reporter& r, const char* name)
+{
+  static constexpr int32_t channels = T::channels;
+  static constexpr int32_t frames = 512;
+
+  T implementation;
+  std::vector<sample_t> in(channels * frames), out(channels * frames);
+  std::mt19937 rng{1234};
+  std::uniform_real_distribution<sample_t> dist{-1., 1.};
+  for (auto& s : in)
+    s = dist(rng);
+
+  sample_t* inputs[channels];
+  sample_t* outputs[channels];
+  for (int32_t c = 0; c < channels; c++)
+  {
+    inputs[c] = in.data() + c * frames;
+    outputs[c] = out.data() + c * frames;
+  }
+
+  const std::string prefix
+      = std::string{name} + (sizeof(sample_t) == 4 ? "/float" : "/double");
+
+  r.run(
+      prefix + "/scalar",
+      channels * frames,
+      [&]
+      {
+        vintage::process_samples_scalar(
+            implementation, inputs, outputs, channels, frames);
+        vintage::bench::do_not_optimize(out[0]);
+      });
+  r.run(
+      prefix + "/simd",
+      channels * frames,
+      [&]
+      {
+        vintage::process_samples(
+            implementation, inputs, outputs, channels, frames);
+        vintage::bench::do_not_optimize(out[0]);
+      });
+}
+
+void per_sample(vintage::bench::reporter& r)
+{
+  compare_drivers<float, Utility>(r, "per_sample/Utility");
+  compare_drivers<double, Utility>(r, "per_sample/Utility");
+  compare_drivers<float, TanhDistortion>(r, "per_sample/TanhDistortion");
+  compare_drivers<double, TanhDistortion>(r, "per_sample/TanhDistortion");
+}
+
+const vintage::bench::register_suite registered{"per_sample", per_sample};
+}
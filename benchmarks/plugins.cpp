@@ -0,0 +1,151 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+// Measures the example plug-ins through their entry points, as a host runs
+// them: processing across block sizes, synth voices, and the parameter
+// functions of the dispatcher.
+
+#include "benchmark.hpp"
+#include "plugins.hpp"
+
+#include <string_view>
+
+namespace
+{
+using vintage::bench::example_plugins;
+using vintage::bench::loaded_plugin;
+
+void hold_chord(loaded_plugin& p, int32_t notes)
+{
+  for (int32_t n = 0; n < notes; n++)
+    p.host->note_on(0, 24 + (n * 7) % 72, 100);
+  p.flush_events();
+}
+
+// Index of the parameter with this name, or -1
+int32_t find_parameter(vintage::test_host& host, std::string_view name)
+{
+  for (int32_t i = 0; i < host.effect->numParams; i++)
+  {
+    char buffer[256]{};
+    host.dispatch(vintage::EffectOpcodes::GetParamName, i, 0, buffer);
+    if (name == buffer)
+      return i;
+  }
+  return -1;
+}
+
+// ns per frame, for each block size and precision
+void block_sizes(vintage::bench::reporter& r)
+{
+  for (const auto& plugin : example_plugins)
+  {
+    for (int32_t block : {16, 64, 256, 1024, 4096})
+    {
+      loaded_plugin p{plugin, block};
+      if (plugin.synth)
+        hold_chord(p, 4);
+
+      const std::string name = std::string{"process/"} + plugin.name
+                               + "/block=" + std::to_string(block);
+      r.run(name + "/float", block, [&] { p.process(); });
+      r.run(name + "/double", block, [&] { p.process_double(); });
+    }
+  }
+}
+
+// ns per frame, for a number of held notes, each with unison voices
+void synth_voices(vintage::bench::reporter& r)
+{
+  static constexpr int32_t block = 512;
+  for (const auto& plugin : example_plugins)
+  {
+    if (!plugin.synth)
+      continue;
+    const int32_t index
+        = find_parameter(*loaded_plugin{plugin, block}.host, "Unison voices");
+    if (index < 0)
+      continue;
+
+    for (int32_t notes : {1, 4, 16, 64})
+    {
+      for (int32_t unison : {1, 2, 4, 8})
+      {
+        loaded_plugin p{plugin, block};
+
+        // Besides the main voice, each note starts one voice for every i
+        // from -u to u in steps of 2, with u = 20 * value: u = unison - 0.5
+        // gives unison of them
+        vintage::Effect& e = *p.host->effect;
+        e.setParameter(&e, index, (unison - 0.5f) / 20.f);
+        hold_chord(p, notes);
+
+        r.run(
+            std::string{"synth/"} + plugin.name + "/notes="
+                + std::to_string(notes) + "/unison=" + std::to_string(unison),
+            block,
+            [&] { p.process(); });
+      }
+    }
+  }
+}
+
+// ns per call of the parameter functions, over all the parameters
+void parameters(vintage::bench::reporter& r)
+{
+  for (const auto& plugin : example_plugins)
+  {
+    loaded_plugin p{plugin, 512};
+    vintage::Effect& e = *p.host->effect;
+    const int32_t count = e.numParams;
+    const std::string name = std::string{"parameters/"} + plugin.name;
+
+    // Values are queued for the audio thread: a block, left out of the
+    // timing, drains the queue before it overflows
+    float value = 0.f;
+    r.run(
+        name + "/setParameter",
+        count,
+        std::max(1, 512 / count),
+        [&]
+        {
+          value = value < 1.f ? value + 0.01f : 0.f;
+          for (int32_t i = 0; i < count; i++)
+            e.setParameter(&e, i, value);
+        },
+        [&] { p.process(); });
+
+    r.run(
+        name + "/getParameter",
+        count,
+        [&]
+        {
+          float sum = 0.f;
+          for (int32_t i = 0; i < count; i++)
+            sum += e.getParameter(&e, i);
+          vintage::bench::do_not_optimize(sum);
+        });
+
+    char text[64]{};
+    r.run(
+        name + "/GetParamDisplay",
+        count,
+        [&]
+        {
+          for (int32_t i = 0; i < count; i++)
+            p.host->dispatch(
+                vintage::EffectOpcodes::GetParamDisplay, i, 0, text);
+          vintage::bench::do_not_optimize(text[0]);
+        });
+  }
+}
+
+const vintage::bench::register_suite registered_blocks{
+    "process",
+    block_sizes};
+const vintage::bench::register_suite registered_voices{
+    "synth",
+    synth_voices};
+const vintage::bench::register_suite registered_parameters{
+    "parameters",
+    parameters};
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/test_host.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vintage::bench
+{
+
+// The example plug-ins, built along with the benchmarks
+struct plugin_path
+{
+  const char* name{};
+  const char* path{};
+  bool synth{};
+};
+
+inline constexpr plugin_path example_plugins[]{
+    {"TanhDistortion", VINTAGE_BENCH_DISTORTION, false},
+    {"Utility", VINTAGE_BENCH_UTILITY, false},
+    {"Osci", VINTAGE_BENCH_OSCI, true},
+    {"Wavetable", VINTAGE_BENCH_WAVETABLE, true},
+};
+
+// A running plug-in, driven directly through its process functions so that
+// the host does not add to the measurements. The inputs hold a sine, so
+// that effects which skip silent blocks do process.
+struct loaded_plugin
+{
+  loaded_plugin(const plugin_path& p, int32_t block_size)
+      : library{p.path}
+      , host{std::make_unique<test_host>(library.entry(), 48000., block_size)}
+      , block_size{block_size}
+  {
+    Effect& e = *host->effect;
+    for (int32_t i = 0; i < e.numParams; i++)
+      e.setParameter(&e, i, 0.5f);
+
+    host->capture = false;
+    host->start();
+
+    const int32_t channels = std::max(e.numInputs, e.numOutputs);
+    buffers.resize(2 * channels * std::size_t(block_size));
+    buffers_double.resize(buffers.size());
+    for (int32_t c = 0; c < channels; c++)
+    {
+      float* in = buffers.data() + c * block_size;
+      double* in_double = buffers_double.data() + c * block_size;
+      for (int32_t i = 0; i < block_size; i++)
+        in[i] = in_double[i] = 0.5 * std::sin(0.0575 * i);
+
+      inputs.push_back(in);
+      outputs.push_back(in + channels * block_size);
+      inputs_double.push_back(in_double);
+      outputs_double.push_back(in_double + channels * block_size);
+    }
+  }
+
+  // Sends the events scheduled on the host
+  void flush_events() { host->render(block_size); }
+
+  void process() noexcept
+  {
+    Effect& e = *host->effect;
+    e.processReplacing(&e, inputs.data(), outputs.data(), block_size);
+  }
+
+  void process_double() noexcept
+  {
+    Effect& e = *host->effect;
+    e.processDoubleReplacing(
+        &e, inputs_double.data(), outputs_double.data(), block_size);
+  }
+
+  plugin_library library;
+  std::unique_ptr<test_host> host;
+  int32_t block_size{};
+
+  std::vector<float> buffers;
+  std::vector<double> buffers_double;
+  std::vector<float*> inputs, outputs;
+  std::vector<double*> inputs_double, outputs_double;
+};
+
+}
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: AGPL-3.0-or-later */
 
+#include <vintage/dsp/envelope.hpp>
+#include <vintage/dsp/fast_math.hpp>
 #include <vintage/polyphonic_synth.hpp>
 
 #include <cmath>
@@ -39,6 +41,13 @@ struct Osci
     } volume;
   } parameters;
 
+  // Voices are rendered in batches of 8 by process_voices
+  static constexpr int32_t lanes = 8;
+
+  // The lanes hold floats: double-precision hosts get converted buffers
+  // rather than a kernel working on half as many voices per register
+  static constexpr bool single_precision = true;
+
   struct voice
   {
     float frequency{};
@@ -49,60 +58,62 @@ struct Osci
     bool recycle{};
 
     float phase{};
+  };
+
+  // Main processing function, will be generated for the float and double
+  // cases. Each inner loop runs across the lanes, that is, across voices.
+  template <typename sample_t>
+  void process_voices(
+      vintage::voice_lanes<channels, lanes>& v,
+      sample_t** outputs,
+      int32_t frames)
+  {
+    constexpr float two_pi = 2. * vintage::pi;
+    const float vol = parameters.volume.value;
+
+    vintage::dsp::lane_envelope<lanes> envelope;
+    envelope.attack = parameters.attack.value * 0.1 * sample_rate;
+    envelope.release = (0.001 + parameters.release.value) * sample_rate;
+    envelope.prepare(v.elapsed, v.release_frame);
+
+    float phi[lanes];
+    float amp[lanes];
+    for (int32_t l = 0; l < lanes; l++)
+    {
+      phi[l] = two_pi * v.frequency[l] / sample_rate;
+      amp[l] = v.volume[l] * vol;
+    }
 
-    // Arguments are the end sample of each
-    template <typename sample_t>
-    auto envelope(int32_t attack, int32_t sustain, int32_t release)
+    for (int32_t i = 0; i < frames; i++)
     {
-      if (elapsed < attack)
+      float sample[lanes];
+      for (int32_t l = 0; l < lanes; l++)
       {
-        return sample_t(elapsed) / sample_t(attack);
+        const float env = envelope.gain(l, float(i));
+        sample[l] = amp[l] * env * vintage::dsp::fast_sin(v.phase[l]);
+
+        // Wrapped with a select rather than a branch, which GCC would not
+        // vectorize across the lanes
+        const float phase = v.phase[l] + phi[l];
+        v.phase[l] = vintage::dsp::detail::select(
+            phase >= two_pi, phase - two_pi, phase);
       }
-      else
+
+      for (int32_t c = 0; c < channels; c++)
       {
-        if (sustain < 0 || elapsed < sustain)
-        {
-          return sample_t{1.0};
-        }
-        else
-        {
-          const int32_t res = release - sustain;
-          if (res > 0 && elapsed < release)
-          {
-            return sample_t(1.) - sample_t(elapsed - sustain) / sample_t(res);
-          }
-          else
-          {
-            recycle = true;
-            return sample_t{0.0};
-          }
-        }
+        float mix = 0.f;
+        for (int32_t l = 0; l < lanes; l++)
+          mix += sample[l] * v.pan[c][l];
+        outputs[c][i] += mix;
       }
     }
 
-    // Main processing function, will be generated for the float and double cases
-    template <typename sample_t>
-    void process(Osci& synth, sample_t** outputs, int32_t frames)
+    for (int32_t l = 0; l < lanes; l++)
     {
-      const sample_t vol = this->volume * synth.parameters.volume.value;
-      const sample_t phi = 2. * vintage::pi * frequency / synth.sample_rate;
-      const int32_t a
-          = synth.parameters.attack.value * 0.1 * synth.sample_rate;
-      const int32_t s = release_frame;
-      const int32_t r
-          = release_frame
-            + (0.001 + synth.parameters.release.value) * synth.sample_rate;
-
-      for (int32_t i = 0; i < frames; i++)
-      {
-        sample_t sample = vol * envelope<sample_t>(a, s, r) * std::sin(phase);
-        for (int32_t c = 0; c < channels; c++)
-          outputs[c][i] += sample * pan[c];
-        phase += phi;
-        elapsed++;
-      }
+      v.elapsed[l] += frames;
+      v.recycle[l] = envelope.finished(v.elapsed[l], v.release_frame[l]);
     }
-  };
+  }
 };
 
 VINTAGE_DEFINE_SYNTH(Osci)
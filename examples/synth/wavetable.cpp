@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/dsp/envelope.hpp>
+#include <vintage/dsp/wavetable.hpp>
+#include <vintage/polyphonic_synth.hpp>
+
+#include <cmath>
+
+struct Wavetable
+{
+  // General metadata
+  static constexpr auto name = "Wavetable";
+  static constexpr auto vendor = "jcelerier";
+  static constexpr auto product = "1.0";
+  static constexpr auto category = vintage::PlugCategory::Synth;
+  static constexpr auto version = 1;
+  static constexpr auto unique_id = 0xCAB1E;
+  static constexpr auto channels = 2;
+
+  int32_t sample_rate = 0;
+  int32_t buffer_size = 0;
+
+  // Definition of the controls
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Waveform"; }
+      auto display() const noexcept
+      {
+        constexpr const char* names[]{"Sine", "Tri", "Saw", "Square"};
+        return names[index()];
+      }
+      int index() const noexcept { return std::min(int(value * 4), 3); }
+
+      float value{0.5};
+    } waveform;
+    struct
+    {
+      constexpr auto name() const noexcept { return "Attack"; }
+      float value{0.05};
+    } attack;
+    struct
+    {
+      constexpr auto name() const noexcept { return "Release"; }
+      float value{0.3};
+    } release;
+    struct
+    {
+      constexpr auto name() const noexcept { return "Volume"; }
+      float value{0.5};
+    } volume;
+  } parameters;
+
+  // The tables are built once per process, when the first instance is created
+  using table_type = vintage::dsp::wavetable<>;
+  const table_type* tables[4]{
+      &vintage::dsp::shared_wavetable<vintage::dsp::waveform::sine>(),
+      &vintage::dsp::shared_wavetable<vintage::dsp::waveform::triangle>(),
+      &vintage::dsp::shared_wavetable<vintage::dsp::waveform::saw>(),
+      &vintage::dsp::shared_wavetable<vintage::dsp::waveform::square>(),
+  };
+
+  struct voice
+  {
+    float frequency{};
+    float volume{};
+    float pan[channels]{};
+    int32_t elapsed{};
+    int32_t release_frame{-1};
+    bool recycle{};
+
+    vintage::dsp::wavetable_oscillator<> oscillator;
+    vintage::dsp::envelope envelope;
+
+    // Main processing function, will be generated for the float and double
+    // cases
+    template <typename sample_t>
+    void process(Wavetable& synth, sample_t** outputs, int32_t frames)
+    {
+      const auto& p = synth.parameters;
+      oscillator.table = synth.tables[p.waveform.index()];
+      oscillator.set_frequency(frequency, synth.sample_rate);
+
+      envelope.attack = p.attack.value * synth.sample_rate;
+      envelope.release = (0.001f + p.release.value) * synth.sample_rate;
+      if (envelope.state() == vintage::dsp::envelope::stage::idle)
+        envelope.start();
+      if (release_frame >= 0)
+        envelope.stop();
+
+      const float vol = this->volume * p.volume.value;
+      for (int32_t start = 0; start < frames; start += 64)
+      {
+        const int32_t n = std::min(64, frames - start);
+        float gain[64];
+        envelope.process(gain, n);
+
+        for (int32_t i = 0; i < n; i++)
+        {
+          const float sample
+              = vol * gain[i]
+                * oscillator.process<vintage::dsp::interpolation::cubic>();
+          for (int32_t c = 0; c < channels; c++)
+            outputs[c][start + i] += sample * pan[c];
+        }
+      }
+
+      elapsed += frames;
+      recycle = envelope.recycle();
+    }
+  };
+};
+
+VINTAGE_DEFINE_SYNTH(Wavetable)
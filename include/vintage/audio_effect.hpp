@@ -2,12 +2,44 @@
 
 /* SPDX-License-Identifier: AGPL-3.0-or-later */
 
+#include <vintage/chunks.hpp>
+#include <vintage/dsp/oversampler.hpp>
+#include <vintage/event_buffer.hpp>
 #include <vintage/helpers.hpp>
+#include <vintage/silence.hpp>
+#include <vintage/simd.hpp>
 #include <vintage/vintage.hpp>
 
 namespace vintage
 {
 
+// Block processors which can read their input after writing their output,
+// e.g. when they only ever process sample by sample, declare
+//
+//   static constexpr bool in_place = true;
+//
+// so that the wrapper passes aliased buffers to them as is. Otherwise it
+// copies the inputs to a scratch buffer first when the host processes in
+// place.
+template <typename T>
+concept in_place_processor = requires
+{
+  requires T::in_place;
+};
+
+// Nonlinear processors declare e.g.
+//
+//   static constexpr int32_t oversampling = 4;
+//
+// to be run at 2, 4 or 8 times the host rate, between half-band
+// upsampling and downsampling filters. The filters add a latency of a few
+// tens of frames, reported to the host. sample_rate stays the host's rate.
+template <typename T>
+concept oversampled_processor = requires
+{
+  T::oversampling;
+};
+
 template <typename T>
 struct SimpleAudioEffect : vintage::Effect
 {
@@ -17,6 +49,7 @@ struct SimpleAudioEffect : vintage::Effect
   Controls<T> controls;
   Processor<T> processor;
   Programs<T> programs;
+  Chunks<T> chunks;
 
   explicit SimpleAudioEffect(vintage::HostCallback master)
       : master{master}
@@ -53,7 +86,6 @@ struct SimpleAudioEffect : vintage::Effect
 
     processor.init(*this);
     controls.init(*this);
-    programs.init(*this);
 
     Effect::numInputs = T::channels;
     Effect::numOutputs = T::channels;
@@ -61,6 +93,8 @@ struct SimpleAudioEffect : vintage::Effect
 
     Effect::flags
         = EffectFlags::CanReplacing | EffectFlags::CanDoubleReplacing;
+    if constexpr (has_tail<T>)
+      Effect::flags = Effect::flags | EffectFlags::NoSoundInStop;
     Effect::ioRatio = 1.;
     Effect::object = nullptr;
     Effect::user = nullptr;
@@ -75,7 +109,30 @@ struct SimpleAudioEffect : vintage::Effect
       implementation.buffer_size
           = request(HostOpcodes::GetBlockSize, 0, 0, nullptr, 0.f);
 
-    controls.read(implementation);
+    controls.read(implementation.parameters);
+    controls.notify(implementation);
+    chunks.init(*this);
+    programs.init(*this);
+
+    if constexpr (oversampled_processor<T>)
+    {
+      static_assert(
+          T::oversampling == 2 || T::oversampling == 4
+              || T::oversampling == 8,
+          "The oversampling factor must be 2, 4 or 8");
+
+      const int32_t frames
+          = request(HostOpcodes::GetBlockSize, 0, 0, nullptr, 0.f);
+      prepare(frames > 0 ? frames : 512);
+      Effect::initialDelay = oversampling_float.latency();
+    }
+
+    if constexpr (!in_place_processor<T>)
+    {
+      scratch_float = std::make_unique<float[]>(T::channels * scratch_frames);
+      scratch_double
+          = std::make_unique<double[]>(T::channels * scratch_frames);
+    }
   }
 
   intptr_t request(HostOpcodes opcode, int a, int b, void* c, float d)
@@ -83,6 +140,173 @@ struct SimpleAudioEffect : vintage::Effect
     return this->master(this, static_cast<int32_t>(opcode), a, b, c, d);
   }
 
+  // Called with the maximum block size, while processing is suspended
+  void prepare(int32_t max_frames)
+  {
+    if constexpr (oversampled_processor<T>)
+    {
+      max_frames = std::max(max_frames, 64);
+      oversampling_float.init(T::oversampling, T::channels, max_frames);
+      oversampling_double.init(T::oversampling, T::channels, max_frames);
+    }
+  }
+
+  // Called when the host suspends processing: the automation points not
+  // yet applied are discarded
+  void reset() noexcept
+  {
+    silence.reset();
+    parameter_events.clear();
+    if constexpr (oversampled_processor<T>)
+    {
+      oversampling_float.reset();
+      oversampling_double.reset();
+    }
+  }
+
+  // Frames of output due once the input is silent: the tail of the
+  // implementation, delayed by the latency. The linear-phase resampling
+  // filters also ring as long after their delay as before it.
+  int64_t tail_length() const noexcept requires has_tail<T>
+  {
+    return implementation.tail_frames + 2 * int64_t(Effect::initialDelay);
+  }
+
+  static constexpr bool block_processor
+      = effect_processor<float, T> || effect_processor<double, T>;
+
+  // True if writing an output could overwrite an input which is still to be
+  // read. The per-sample driver reads each frame before writing it, so a
+  // channel processed in place is only a problem for block processors.
+  template <typename sample_t>
+  static bool aliased(sample_t** inputs, sample_t** outputs) noexcept
+  {
+    if constexpr (in_place_processor<T>)
+      return false;
+
+    for (int32_t c = 0; c < T::channels; c++)
+      for (int32_t d = 0; d < T::channels; d++)
+        if (outputs[c] == inputs[d] && (c != d || block_processor))
+          return true;
+    return false;
+  }
+
+  template <typename sample_t>
+  void run(sample_t** inputs, sample_t** outputs, int32_t frames)
+  {
+    if constexpr (requires
+                  { implementation.process(inputs, outputs, frames); })
+    {
+      implementation.process(inputs, outputs, frames);
+    }
+    else if constexpr (requires {
+                         outputs[0][0] = implementation.process(inputs[0][0]);
+                       })
+    {
+      process_samples(implementation, inputs, outputs, T::channels, frames);
+    }
+  }
+
+  // All the inputs are upsampled before any output is written: aliased
+  // buffers are not a concern
+  template <typename sample_t>
+  void run_oversampled(sample_t** inputs, sample_t** outputs, int32_t frames)
+  {
+    auto& oversampling = [this]() -> auto&
+    {
+      if constexpr (std::is_same_v<sample_t, float>)
+        return oversampling_float;
+      else
+        return oversampling_double;
+    }();
+
+    const int32_t max_frames = oversampling.max_frames;
+    for (int32_t offset = 0; offset < frames; offset += max_frames)
+    {
+      const int32_t n = std::min(max_frames, frames - offset);
+      sample_t* high_inputs[T::channels];
+      sample_t* high_outputs[T::channels];
+      for (int32_t c = 0; c < T::channels; c++)
+      {
+        oversampling.upsample(c, inputs[c] + offset, n);
+        high_inputs[c] = oversampling.input(c);
+        high_outputs[c] = oversampling.output(c);
+      }
+
+      run(high_inputs, high_outputs, n * T::oversampling);
+
+      for (int32_t c = 0; c < T::channels; c++)
+        oversampling.downsample(c, outputs[c] + offset, n);
+    }
+  }
+
+  // Processes the frames [start; start + frames) of the buffers
+  template <typename sample_t>
+  void process_sub_block(
+      sample_t** inputs,
+      sample_t** outputs,
+      int32_t start,
+      int32_t frames)
+  {
+    sample_t* sub_inputs[T::channels];
+    sample_t* sub_outputs[T::channels];
+    for (int32_t c = 0; c < T::channels; c++)
+    {
+      sub_inputs[c] = inputs[c] + start;
+      sub_outputs[c] = outputs[c] + start;
+    }
+
+    if constexpr (oversampled_processor<T>)
+    {
+      run_oversampled(sub_inputs, sub_outputs, frames);
+      return;
+    }
+
+    if (!aliased(sub_inputs, sub_outputs))
+    {
+      run(sub_inputs, sub_outputs, frames);
+      return;
+    }
+
+    // In-place processing by an implementation which does not support it:
+    // the inputs are copied aside, a chunk at a time
+    sample_t* scratch;
+    if constexpr (std::is_same_v<sample_t, float>)
+      scratch = scratch_float.get();
+    else
+      scratch = scratch_double.get();
+
+    for (int32_t offset = 0; offset < frames; offset += scratch_frames)
+    {
+      const int32_t n = std::min(scratch_frames, frames - offset);
+      sample_t* copies[T::channels];
+      sample_t* chunk_outputs[T::channels];
+      for (int32_t c = 0; c < T::channels; c++)
+      {
+        copies[c] = scratch + c * scratch_frames;
+        std::copy_n(sub_inputs[c] + offset, n, copies[c]);
+        chunk_outputs[c] = sub_outputs[c] + offset;
+      }
+      run(copies, chunk_outputs, n);
+    }
+  }
+
+  // The parameters still change, and the inputs are copied to the outputs
+  // unless they are the same buffers
+  template <typename sample_t>
+  void bypass(sample_t** inputs, sample_t** outputs, int32_t frames)
+  {
+    controls.write(implementation);
+    chunks.write(implementation);
+    for (const auto& event : parameter_events)
+      controls.apply(implementation, event);
+    parameter_events.clear();
+
+    for (int32_t c = 0; c < T::channels; c++)
+      if (inputs[c] != outputs[c])
+        std::copy_n(inputs[c], frames, outputs[c]);
+  }
+
   void process(
       std::floating_point auto** inputs,
       std::floating_point auto** outputs,
@@ -92,31 +316,61 @@ struct SimpleAudioEffect : vintage::Effect
     if constexpr (requires { implementation.bypass; })
     {
       if (implementation.bypass)
+      {
+        bypass(inputs, outputs, sampleFrames);
         return;
+      }
     }
 
     // Before processing starts, we copy all our atomics back into the struct
     controls.write(implementation);
+    chunks.write(implementation);
 
-    // Actual processing
-    if constexpr (requires
-                  { implementation.process(inputs, outputs, sampleFrames); })
+    // Idle: parameters keep changing, but nothing is processed
+    if constexpr (has_tail<T>)
     {
-      return implementation.process(inputs, outputs, sampleFrames);
+      if (silence.update(
+              silence_detector::is_silent(inputs, T::channels, sampleFrames),
+              sampleFrames,
+              tail_length()))
+      {
+        for (const auto& event : parameter_events)
+          controls.apply(implementation, event);
+        parameter_events.clear();
+
+        silence_detector::clear(outputs, T::channels, sampleFrames);
+        return;
+      }
     }
-    else if constexpr (requires {
-                         outputs[0][0] = implementation.process(inputs[0][0]);
-                       })
+
+    // Actual processing, split at each automation point so that parameters
+    // change at the exact frame requested by the host.
+    int32_t start = 0;
+    for (const auto& event : parameter_events)
     {
-      for (int32_t c = 0; c < implementation.channels; ++c)
+      const int32_t frame = std::clamp(event.deltaFrames, start, sampleFrames);
+      if (frame > start)
       {
-        for (int32_t i = 0; i < sampleFrames; i++)
-        {
-          outputs[c][i] = implementation.process(inputs[c][i]);
-        }
+        process_sub_block(inputs, outputs, start, frame - start);
+        start = frame;
       }
+      controls.apply(implementation, event);
     }
+    parameter_events.clear();
+
+    if (start < sampleFrames)
+      process_sub_block(inputs, outputs, start, sampleFrames - start);
   }
+
+  event_buffer<vintage::ParameterEvent, 512> parameter_events;
+  silence_detector silence;
+
+  dsp::oversampler<float> oversampling_float;
+  dsp::oversampler<double> oversampling_double;
+
+  static constexpr int32_t scratch_frames = 512;
+  std::unique_ptr<float[]> scratch_float;
+  std::unique_ptr<double[]> scratch_double;
 };
 }
 
@@ -0,0 +1,231 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/helpers.hpp>
+#include <vintage/triple_buffer.hpp>
+#include <vintage/vintage.hpp>
+
+#include <bit>
+#include <cinttypes>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace vintage
+{
+
+template <typename T>
+concept has_extra_state = requires(T t)
+{
+  t.state;
+  requires std::is_trivially_copyable_v<decltype(T::state)>;
+};
+
+template <typename T>
+struct extra_state
+{
+  struct type
+  {
+  };
+};
+
+template <has_extra_state T>
+struct extra_state<T>
+{
+  using type = decltype(T::state);
+};
+
+// Saves and restores the whole state of a plug-in in one call, instead of
+// hosts calling getParameter and setParameter for each parameter.
+//
+// Besides the parameters, implementations can declare a trivially copyable
+// `state` member holding other settings to be saved with the session. It is
+// set once by the implementation's initializers, then only by SetChunk, and
+// replaced at the start of a block: process() must not modify it. The
+// dispatcher thread keeps its own copy of the latest state, which GetChunk
+// saves: it holds a restored state even before the audio thread picks it
+// up, and is never read while the audio thread writes.
+//
+// Chunk format, version 1, all fields 32-bit little-endian:
+//
+//   magic "vntg", format version, unique id, plug-in version,
+//   current program, parameter count N, N float values,
+//   state size S, S bytes of state.
+//
+// Chunks with fewer parameters than the plug-in, e.g. saved by a previous
+// version of it, leave the remaining parameters unchanged; the state is
+// restored only if its size matches.
+template <typename T>
+struct Chunks
+{
+  static constexpr uint32_t magic = 0x67746E76; // "vntg"
+  static constexpr uint32_t format_version = 1;
+  static constexpr int32_t header_size = 6 * 4;
+
+  template <typename Effect_T>
+  void init(Effect_T& effect)
+  {
+    effect.Effect::flags = effect.Effect::flags | EffectFlags::ProgramChunks;
+
+    int32_t state_size = 0;
+    if constexpr (has_extra_state<T>)
+      state_size = sizeof(T::state);
+
+    buffer = std::make_unique<char[]>(
+        header_size + 4 * effect.numParams + 4 + state_size);
+
+    if constexpr (has_extra_state<T>)
+      latest_state = effect.implementation.state;
+  }
+
+  // GetChunk: returns the size of the chunk, which stays valid until the
+  // next call
+  template <typename Effect_T>
+  intptr_t get(Effect_T& effect, void** data) noexcept
+  {
+    char* p = buffer.get();
+    put(p, magic);
+    put(p, format_version);
+    put(p, uint32_t(T::unique_id));
+    put(p, uint32_t(T::version));
+
+    put(p, uint32_t(current_program(effect)));
+
+    put(p, uint32_t(effect.numParams));
+    for (int32_t i = 0; i < effect.numParams; i++)
+      put(
+          p,
+          std::bit_cast<uint32_t>(effect.Effect::getParameter(&effect, i)));
+
+    if constexpr (has_extra_state<T>)
+    {
+      put(p, uint32_t(sizeof(T::state)));
+      std::memcpy(p, &latest_state, sizeof(T::state));
+      p += sizeof(T::state);
+    }
+    else
+    {
+      put(p, uint32_t(0));
+    }
+
+    *data = buffer.get();
+    return p - buffer.get();
+  }
+
+  // SetChunk: returns 0 if the chunk is not ours or is corrupted
+  template <typename Effect_T>
+  intptr_t set(Effect_T& effect, const void* data, intptr_t size) noexcept
+  {
+    const char* p = static_cast<const char*>(data);
+    const char* end = p + size;
+    if (!data || size < header_size)
+      return 0;
+
+    if (take(p) != magic)
+      return 0;
+    if (take(p) > format_version)
+      return 0;
+    if (take(p) != uint32_t(T::unique_id))
+      return 0;
+    take(p); // Plug-in version, for future migrations
+    const uint32_t program = take(p);
+    const uint32_t count = take(p);
+    if (count > uint32_t(end - p) / 4)
+      return 0;
+
+    // Parameters which are not in the chunk keep their current value
+    auto& controls = effect.controls;
+    auto& params = staged_parameters;
+    const char* values = p;
+    auto value = [&controls, values, count](uint32_t i)
+    {
+      if (i >= count)
+        return controls.parameters[i].load(std::memory_order_relaxed);
+      const char* v = values + 4 * i;
+      return std::bit_cast<float>(take(v));
+    };
+    [&params, &value]<std::size_t... Index>(
+        std::integer_sequence<std::size_t, Index...>)
+    {
+      ((boost::pfr::get<Index>(params).value = value(Index)), ...);
+    }
+    (std::make_index_sequence<Controls<T>::parameter_count>());
+
+    // Parameters handled by the wrapper, e.g. unison for synths
+    for (int32_t i = Controls<T>::parameter_count;
+         i < int32_t(count) && i < effect.numParams;
+         i++)
+      effect.Effect::setParameter(&effect, i, value(i));
+    p = values + 4 * count;
+
+    controls.stage(params);
+
+    // Programs of the implementation or of its preset bank
+    if (program < uint32_t(effect.numPrograms))
+    {
+      if constexpr (requires { effect.programs.current; })
+        effect.programs.current = int32_t(program);
+      if constexpr (requires { effect.implementation.current_program; })
+        effect.implementation.current_program = int32_t(program);
+    }
+
+    if constexpr (has_extra_state<T>)
+    {
+      if (end - p >= 4 && take(p) == sizeof(T::state)
+          && end - p >= intptr_t(sizeof(T::state)))
+      {
+        std::memcpy(&latest_state, p, sizeof(T::state));
+        state.back() = latest_state;
+        state.publish();
+      }
+    }
+    return 1;
+  }
+
+  // Called at the start of each block to apply a restored state
+  void write(T& implementation) noexcept
+  {
+    if constexpr (has_extra_state<T>)
+    {
+      if (state.consume())
+        implementation.state = state.front();
+    }
+  }
+
+private:
+  // As answered to GetProgram
+  template <typename Effect_T>
+  static int32_t current_program(Effect_T& effect) noexcept
+  {
+    if constexpr (requires { effect.programs.bank; })
+    {
+      if (effect.programs.bank.size() > 0)
+        return effect.programs.current;
+    }
+    if constexpr (requires { effect.implementation.current_program; })
+      return effect.implementation.current_program;
+    return 0;
+  }
+
+  static void put(char*& p, uint32_t v) noexcept
+  {
+    for (int32_t i = 0; i < 4; i++)
+      *p++ = char(v >> (8 * i));
+  }
+
+  static uint32_t take(const char*& p) noexcept
+  {
+    uint32_t v = 0;
+    for (int32_t i = 0; i < 4; i++)
+      v |= uint32_t(uint8_t(*p++)) << (8 * i);
+    return v;
+  }
+
+  std::unique_ptr<char[]> buffer;
+  decltype(T::parameters) staged_parameters{};
+  typename extra_state<T>::type latest_state{};
+  triple_buffer<typename extra_state<T>::type> state;
+};
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <cinttypes>
+#include <type_traits>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#define VINTAGE_DENORMALS_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define VINTAGE_DENORMALS_ARM64 1
+#endif
+
+namespace vintage
+{
+
+// Flushes denormal numbers to zero for its lifetime, then restores the
+// floating-point environment of the calling thread.
+//
+// Decaying signals, e.g. envelope and filter tails, end up in the denormal
+// range where each operation can take a hundred times longer. With this
+// set, denormal results are flushed to zero (FTZ) and denormal inputs are
+// read as zero (DAZ on x86; FZ covers both on AArch64).
+//
+// The wrappers set it around every process call. Implementations which
+// need denormals opt out with
+//
+//   static constexpr bool flush_denormals = false;
+struct denormal_scope
+{
+  denormal_scope() noexcept
+  {
+#if defined(VINTAGE_DENORMALS_SSE)
+    state = _mm_getcsr();
+    _mm_setcsr(state | ftz | daz);
+#elif defined(VINTAGE_DENORMALS_ARM64) && defined(_MSC_VER)
+    state = _ReadStatusReg(ARM64_FPCR);
+    _WriteStatusReg(ARM64_FPCR, state | fz);
+#elif defined(VINTAGE_DENORMALS_ARM64)
+    asm volatile("mrs %0, fpcr" : "=r"(state));
+    asm volatile("msr fpcr, %0" : : "r"(state | fz));
+#endif
+  }
+
+  ~denormal_scope()
+  {
+#if defined(VINTAGE_DENORMALS_SSE)
+    _mm_setcsr(state);
+#elif defined(VINTAGE_DENORMALS_ARM64) && defined(_MSC_VER)
+    _WriteStatusReg(ARM64_FPCR, state);
+#elif defined(VINTAGE_DENORMALS_ARM64)
+    asm volatile("msr fpcr, %0" : : "r"(state));
+#endif
+  }
+
+  denormal_scope(const denormal_scope&) = delete;
+  denormal_scope& operator=(const denormal_scope&) = delete;
+
+private:
+#if defined(VINTAGE_DENORMALS_SSE)
+  static constexpr uint32_t ftz = 1 << 15;
+  static constexpr uint32_t daz = 1 << 6;
+  uint32_t state{};
+#elif defined(VINTAGE_DENORMALS_ARM64)
+  static constexpr uint64_t fz = uint64_t(1) << 24;
+  uint64_t state{};
+#endif
+};
+
+template <typename T>
+concept flushes_denormals = !requires
+{
+  requires !T::flush_denormals;
+};
+
+struct no_denormal_scope
+{
+};
+
+// What the wrappers set around the process calls of T
+template <typename T>
+using denormal_scope_for = std::conditional_t<
+    flushes_denormals<T>,
+    denormal_scope,
+    no_denormal_scope>;
+
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/dsp/fast_math.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+namespace vintage::dsp
+{
+
+enum class ramp
+{
+  linear,
+  exponential
+};
+
+// ADSR envelope generator, rendered a block at a time.
+//
+// The coefficients of a segment are computed once, when it starts. Within a
+// block, each segment is filled by a loop whose frames do not depend on each
+// other, which the compiler vectorizes: exponential segments are evaluated
+// eight frames at a time from precomputed powers of their coefficient.
+//
+// Exponential segments reach -60 dB of their distance to the target at the
+// end of the segment, then snap to it.
+//
+// A synth voice drives it with start() upon note on and stop() upon note
+// off; recycle() tells when the release is over.
+struct envelope
+{
+  enum class stage : uint8_t
+  {
+    idle,
+    attack,
+    decay,
+    sustain,
+    release,
+    finished
+  };
+
+  // Durations in frames; sustain is a gain in [0; 1], read while sustaining
+  // so that it can change at any time. Durations apply to the next segments.
+  float attack{};
+  float decay{};
+  float sustain{1.f};
+  float release{};
+
+  ramp attack_ramp{ramp::linear};
+  ramp decay_ramp{ramp::exponential};
+  ramp release_ramp{ramp::exponential};
+
+  // Starts from the current level, so that retriggering does not click
+  void start() noexcept { enter(stage::attack); }
+
+  void stop() noexcept
+  {
+    if (current != stage::idle && current != stage::release
+        && current != stage::finished)
+      enter(stage::release);
+  }
+
+  void reset() noexcept
+  {
+    current = stage::idle;
+    level = 0.f;
+  }
+
+  stage state() const noexcept { return current; }
+  float value() const noexcept { return level; }
+
+  // Set once the release is over
+  bool recycle() const noexcept { return current == stage::finished; }
+
+  // Writes the gains of the next frames
+  void process(float* gains, int32_t frames) noexcept
+  {
+    int32_t done = 0;
+    while (done < frames)
+    {
+      if (current == stage::sustain)
+        level = sustain;
+      if (!timed())
+      {
+        std::fill_n(gains + done, frames - done, level);
+        return;
+      }
+
+      const int32_t n = std::min(remaining, frames - done);
+      if (shape == ramp::linear)
+        fill_linear(gains + done, n);
+      else
+        fill_exponential(gains + done, n);
+
+      done += n;
+      remaining -= n;
+      if (remaining == 0)
+      {
+        level = target;
+        enter(next());
+      }
+    }
+  }
+
+private:
+  bool timed() const noexcept
+  {
+    return current == stage::attack || current == stage::decay
+           || current == stage::release;
+  }
+
+  stage next() const noexcept
+  {
+    switch (current)
+    {
+      case stage::attack:
+        return stage::decay;
+      case stage::decay:
+        return stage::sustain;
+      case stage::release:
+        return stage::finished;
+      default:
+        return current;
+    }
+  }
+
+  void enter(stage s) noexcept
+  {
+    current = s;
+    switch (s)
+    {
+      case stage::attack:
+        begin(attack, 1.f, attack_ramp);
+        break;
+      case stage::decay:
+        begin(decay, sustain, decay_ramp);
+        break;
+      case stage::release:
+        begin(release, 0.f, release_ramp);
+        break;
+      case stage::finished:
+        level = 0.f;
+        break;
+      default:
+        break;
+    }
+  }
+
+  void begin(float duration, float goal, ramp r) noexcept
+  {
+    remaining = std::max(1, int32_t(duration));
+    target = goal;
+    shape = r;
+
+    if (r == ramp::linear)
+    {
+      step = (goal - level) / remaining;
+    }
+    else
+    {
+      // -60 dB after `remaining` frames
+      const float c = std::exp(-6.907755f / remaining);
+      float p = c;
+      for (float& power : powers)
+      {
+        power = p;
+        p *= c;
+      }
+    }
+  }
+
+  void fill_linear(float* gains, int32_t n) noexcept
+  {
+    const float start = level;
+    const float slope = step;
+    for (int32_t i = 0; i < n; i++)
+      gains[i] = start + slope * float(i + 1);
+    level = start + slope * float(n);
+  }
+
+  void fill_exponential(float* gains, int32_t n) noexcept
+  {
+    const float goal = target;
+    float offset = level - goal;
+
+    int32_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      for (int32_t k = 0; k < 8; k++)
+        gains[i + k] = goal + offset * powers[k];
+      offset *= powers[7];
+    }
+    if (i < n)
+    {
+      for (int32_t k = 0; k < n - i; k++)
+        gains[i + k] = goal + offset * powers[k];
+      offset *= powers[n - i - 1];
+    }
+    level = goal + offset;
+  }
+
+  float powers[8]{};
+  float level{};
+  float target{};
+  float step{};
+  int32_t remaining{};
+  ramp shape{ramp::linear};
+  stage current{stage::idle};
+};
+
+// Attack-sustain-release envelope of a batch of voices rendered lane-wise.
+//
+// Its gain is a function of the frames elapsed since note on and of the
+// release frame, which voice_lanes gathers, so that the voices need no
+// other state: the linear attack, clamped at full level, and the linear
+// release, from full level at the release frame, are evaluated together
+// and the lower one wins. prepare() computes the coefficients of both
+// segments once per block; gain() is then branch-free across the lanes.
+template <int32_t Width>
+struct lane_envelope
+{
+  // Durations in frames
+  float attack{1.f};
+  float release{1.f};
+
+  void prepare(const int32_t* elapsed, const int32_t* release_frame) noexcept
+  {
+    const float rise = 1.f / std::max(1.f, attack);
+    const float fall = 1.f / std::max(1.f, release);
+    for (int32_t l = 0; l < Width; l++)
+    {
+      attack_start[l] = elapsed[l] * rise;
+      attack_step[l] = rise;
+
+      // Held: a release segment which never goes below full level
+      const bool held = release_frame[l] < 0;
+      release_start[l]
+          = held ? 1.f : 1.f - (elapsed[l] - release_frame[l]) * fall;
+      release_step[l] = held ? 0.f : -fall;
+    }
+  }
+
+  // Gain of a lane at the frame `frame` of the block, meant to be inlined
+  // in a loop across the lanes
+  float gain(int32_t lane, float frame) const noexcept
+  {
+    // detail::min and max rather than std::min: GCC does not vectorize the
+    // branches of the latter
+    const float rising = attack_start[lane] + frame * attack_step[lane];
+    const float falling = release_start[lane] + frame * release_step[lane];
+    return detail::max(0.f, detail::min(1.f, detail::min(rising, falling)));
+  }
+
+  // Whether the release of a voice is over after `elapsed` frames
+  bool finished(int32_t elapsed, int32_t release_frame) const noexcept
+  {
+    return release_frame >= 0 && elapsed >= release_frame + release;
+  }
+
+private:
+  alignas(64) float attack_start[Width]{};
+  alignas(64) float attack_step[Width]{};
+  alignas(64) float release_start[Width]{};
+  alignas(64) float release_step[Width]{};
+};
+
+}
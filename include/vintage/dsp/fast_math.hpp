@@ -0,0 +1,270 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/simd.hpp>
+
+#include <bit>
+#include <cinttypes>
+#include <concepts>
+#include <limits>
+#include <type_traits>
+
+// Branch-free approximations of common transcendental functions.
+//
+// They are made only of arithmetic and selects so that the compiler can
+// inline them and vectorize the loops which call them, unlike calls into
+// libm. tanh, sin and cos also accept vintage::simd packs, which makes them
+// usable in per-sample processors driven over packs.
+//
+// Range reductions rely on IEEE rounding: -fassociative-math (implied by
+// -ffast-math) would fold them away.
+//
+// The maximum errors below were measured against libm evaluated in double
+// precision, on a dense grid over the given range.
+// See benchmarks/fast_math.cpp for the speed-up.
+
+namespace vintage::dsp
+{
+namespace detail
+{
+// Element type, for writing constants which can be broadcast to packs
+template <typename T>
+struct scalar
+{
+  using type = T;
+};
+
+template <typename T>
+using scalar_t = typename scalar<T>::type;
+
+template <std::floating_point T>
+using bits_t = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+// Blends with a bit mask instead of `mask ? a : b`: with the default
+// -ftrapping-math, compilers move the computation of a and b inside the
+// branches of a ternary and then refuse to vectorize the resulting loop.
+template <std::floating_point T>
+inline T select(bool mask, T a, T b) noexcept
+{
+  const bits_t<T> m = -bits_t<T>(mask);
+  return std::bit_cast<T>(
+      (std::bit_cast<bits_t<T>>(a) & m) | (std::bit_cast<bits_t<T>>(b) & ~m));
+}
+
+template <std::floating_point T>
+inline T min(T a, T b) noexcept
+{
+  return select(a < b, a, b);
+}
+
+template <std::floating_point T>
+inline T max(T a, T b) noexcept
+{
+  return select(a < b, b, a);
+}
+
+// Round to nearest, ties to even, valid for |x| < 2^(digits - 2) which is
+// more than enough for range reductions. Adding and subtracting 1.5 * 2^m
+// lets the FPU do the rounding; unlike a conversion to int64 it vectorizes
+// on every SIMD instruction set.
+template <std::floating_point T>
+inline T round(T x) noexcept
+{
+  constexpr int mantissa = std::numeric_limits<T>::digits - 1;
+  constexpr T magic = T(1.5) * T(bits_t<T>(1) << mantissa);
+  return (x + magic) - magic;
+}
+
+#if VINTAGE_HAS_SIMD
+template <simd_pack T>
+struct scalar<T>
+{
+  using type = typename T::value_type;
+};
+
+template <simd_pack T>
+inline T select(typename T::mask_type mask, T a, T b) noexcept
+{
+  std::experimental::where(mask, b) = a;
+  return b;
+}
+
+template <simd_pack T>
+inline T min(T a, T b) noexcept
+{
+  return std::experimental::min(a, b);
+}
+
+template <simd_pack T>
+inline T max(T a, T b) noexcept
+{
+  return std::experimental::max(a, b);
+}
+
+template <simd_pack T>
+inline T round(T x) noexcept
+{
+  return std::experimental::round(x);
+}
+#endif
+}
+
+// Max absolute error: 2.1e-7 in float, 4e-9 in double.
+// A [5/4] rational approximation from Lambert's continued fraction is
+// evaluated on x/4, where it is very precise, then brought back to x with
+// the doubling formula tanh(2u) = 2 tanh(u) / (1 + tanh(u)^2), which shrinks
+// the error as tanh saturates. The fraction is kept as numerator and
+// denominator until the end, so there is a single division.
+template <vintage::sample T>
+inline T fast_tanh(T x) noexcept
+{
+  using S = detail::scalar_t<T>;
+  x = detail::max(T(S(-10)), detail::min(x, T(S(10))));
+
+  const T u = x * S(0.25);
+  const T u2 = u * u;
+  T num = u * (S(945) + u2 * (S(105) + u2));
+  T den = S(945) + u2 * (S(420) + u2 * S(15));
+
+  for (int i = 0; i < 2; i++)
+  {
+    const T n = S(2) * num * den;
+    den = num * num + den * den;
+    num = n;
+  }
+  return num / den;
+}
+
+// Max absolute error: 2.2e-7 in float, 6e-8 in double for |x| < 7.
+// The argument is reduced to [-pi/2, pi/2] and evaluated with a degree 11
+// odd polynomial. As for any range reduction done in the precision of the
+// argument, the error grows with |x|: up to 1.3e-3 in float for |x| < 1e4,
+// thus keep phases wrapped.
+template <vintage::sample T>
+inline T fast_sin(T x) noexcept
+{
+  using S = detail::scalar_t<T>;
+  constexpr double pi = 3.141592653589793238462643383279502884;
+  const T k = detail::round(T(x * S(1. / (2. * pi))));
+  x = x - k * S(2. * pi);
+
+  // Fold [pi/2, pi] and [-pi, -pi/2] on [-pi/2, pi/2]
+  x = detail::select(x > S(pi / 2.), T(S(pi) - x), x);
+  x = detail::select(x < S(-pi / 2.), T(S(-pi) - x), x);
+
+  const T x2 = x * x;
+  return x
+         * (S(1)
+            + x2
+                  * (S(-1. / 6.)
+                     + x2
+                           * (S(1. / 120.)
+                              + x2
+                                    * (S(-1. / 5040.)
+                                       + x2
+                                             * (S(1. / 362880.)
+                                                + x2 * S(-1. / 39916800.))))));
+}
+
+// Same accuracy as fast_sin in double. In float, adding pi/2 rounds the
+// argument: the max absolute error is 4.4e-7 for |x| < 7.
+template <vintage::sample T>
+inline T fast_cos(T x) noexcept
+{
+  using S = detail::scalar_t<T>;
+  constexpr double pi = 3.141592653589793238462643383279502884;
+  return fast_sin(T(x + S(pi / 2.)));
+}
+
+// Max relative error: 2.5e-7 in float for x in [-126, 127], 1.7e-7 in
+// double for x in [-1022, 1023]; the input is clamped to this range.
+// 2^round(x) is built directly in the exponent bits and 2^fract(x)
+// is approximated with a degree 6 polynomial on [-0.5, 0.5].
+template <std::floating_point T>
+inline T fast_exp2(T x) noexcept
+{
+  constexpr int mantissa = std::numeric_limits<T>::digits - 1;
+  constexpr int bias = std::numeric_limits<T>::max_exponent - 1;
+
+  using bits_t = detail::bits_t<T>;
+  constexpr T magic = T(1.5) * T(bits_t(1) << mantissa);
+
+  x = detail::max(T(1 - bias), detail::min(x, T(bias)));
+
+  // Round x: the low bits of the mantissa of (x + magic) hold round(x)
+  const T shifted = x + magic;
+  const T n = shifted - magic;
+  const T f = x - n;
+
+  constexpr T ln2 = 0.693147180559945309417232121458176568;
+  const T y = f * ln2;
+  const T p
+      = T(1)
+        + y
+              * (T(1)
+                 + y
+                       * (T(1. / 2.)
+                          + y
+                                * (T(1. / 6.)
+                                   + y
+                                         * (T(1. / 24.)
+                                            + y
+                                                  * (T(1. / 120.)
+                                                     + y * T(1. / 720.))))));
+
+  const T scale
+      = std::bit_cast<T>((std::bit_cast<bits_t>(shifted) + bias) << mantissa);
+  return p * scale;
+}
+
+// For normal, positive x: max absolute error 1.1e-9 in double, max
+// relative error 3e-7 in float, that is within 4 ulps.
+// The exponent is read from the bits and the mantissa, normalized to
+// [sqrt(2)/2, sqrt(2)], is approximated with the atanh series.
+template <std::floating_point T>
+inline T fast_log2(T x) noexcept
+{
+  using int_t = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+  constexpr int mantissa = std::numeric_limits<T>::digits - 1;
+  constexpr int bias = std::numeric_limits<T>::max_exponent - 1;
+  constexpr int_t mantissa_mask = (int_t(1) << mantissa) - 1;
+  constexpr double sqrt2 = 1.41421356237309504880168872420969808;
+
+  const int_t bits = std::bit_cast<int_t>(x);
+  T e = T((bits >> mantissa) - bias);
+  T m = std::bit_cast<T>((bits & mantissa_mask) | (int_t(bias) << mantissa));
+
+  const bool high = m > T(sqrt2);
+  m = detail::select(high, m * T(0.5), m);
+  e = detail::select(high, e + T(1), e);
+
+  constexpr T inv_ln2 = 1.44269504088896340735992468100189214;
+  const T t = (m - T(1)) / (m + T(1));
+  const T t2 = t * t;
+  const T s
+      = t
+        * (T(1)
+           + t2
+                 * (T(1. / 3.)
+                    + t2
+                          * (T(1. / 5.)
+                             + t2 * (T(1. / 7.) + t2 * T(1. / 9.)))));
+  return e + T(2) * inv_ln2 * s;
+}
+
+// Frequency ratio for an interval in semitones, e.g. for pitch bends.
+// Same accuracy as fast_exp2.
+template <std::floating_point T>
+inline T fast_semitones_to_ratio(T semitones) noexcept
+{
+  return fast_exp2(semitones * T(1. / 12.));
+}
+
+// Frequency of a MIDI note in 12-tone equal temperament
+template <std::floating_point T>
+inline T fast_note_to_frequency(T note, T a4 = T(440)) noexcept
+{
+  return a4 * fast_semitones_to_ratio(note - T(69));
+}
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cmath>
+#include <memory>
+
+namespace vintage::dsp
+{
+namespace detail
+{
+// Modified Bessel function of the first kind of order 0, for Kaiser windows
+inline double bessel_i0(double x) noexcept
+{
+  double sum = 1., term = 1.;
+  for (int32_t k = 1; k < 32; k++)
+  {
+    const double r = x / (2. * k);
+    term *= r * r;
+    sum += term;
+  }
+  return sum;
+}
+
+// Non-zero taps of a Kaiser-windowed half-band lowpass of length
+// 4 * order + 3, for orders up to 30. All the even taps are zero except the
+// central one, which is 1/2: this writes the 2 * order + 2 odd ones, scaled
+// by gain.
+template <typename sample_t>
+void design_half_band(int32_t order, double gain, sample_t* taps) noexcept
+{
+  constexpr double pi = 3.141592653589793238462643383279502884;
+  constexpr double beta = 8.;
+  const int32_t half_length = 2 * order + 1;
+  const int32_t count = 2 * order + 2;
+
+  double h[64];
+  double sum = 0.;
+  for (int32_t t = 0; t < count; t++)
+  {
+    const int32_t n = 2 * (order - t) + 1;
+    const double x = double(n) / (half_length + 1);
+    const double window
+        = bessel_i0(beta * std::sqrt(1. - x * x)) / bessel_i0(beta);
+    h[t] = std::sin(pi * n / 2.) / (pi * n) * window;
+    sum += h[t];
+  }
+
+  // The odd taps add up to 1/2 for a unity gain at DC
+  for (int32_t t = 0; t < count; t++)
+    taps[t] = sample_t(h[t] * 0.5 / sum * gain);
+}
+}
+
+// Doubles the rate of a signal. The half-band filter is split in its two
+// phases: one is a pure delay, the other an FIR evaluated one tap at a time
+// over the whole block, so that the inner loop vectorizes.
+template <typename sample_t>
+struct half_band_upsampler
+{
+  void init(int32_t order, int32_t max_frames)
+  {
+    this->order = order;
+    taps = 2 * order + 2;
+    coefficients = std::make_unique<sample_t[]>(taps);
+    detail::design_half_band(order, 2., coefficients.get());
+    history = std::make_unique<sample_t[]>(taps - 1 + max_frames);
+    odd = std::make_unique<sample_t[]>(max_frames);
+  }
+
+  void reset() noexcept { std::fill_n(history.get(), taps - 1, sample_t(0)); }
+
+  // Writes 2 * frames samples. out may be in.
+  void process(const sample_t* in, sample_t* out, int32_t frames) noexcept
+  {
+    sample_t* x = history.get();
+    std::copy_n(in, frames, x + taps - 1);
+
+    sample_t* acc = odd.get();
+    std::fill_n(acc, frames, sample_t(0));
+    for (int32_t t = 0; t < taps; t++)
+    {
+      const sample_t c = coefficients[t];
+      const sample_t* window = x + t;
+      for (int32_t k = 0; k < frames; k++)
+        acc[k] += c * window[k];
+    }
+
+    for (int32_t k = 0; k < frames; k++)
+    {
+      out[2 * k] = x[k + order];
+      out[2 * k + 1] = acc[k];
+    }
+
+    std::copy_n(x + frames, taps - 1, x);
+  }
+
+  // In frames of the input rate
+  int32_t order{};
+  int32_t taps{};
+  std::unique_ptr<sample_t[]> coefficients;
+  std::unique_ptr<sample_t[]> history;
+  std::unique_ptr<sample_t[]> odd;
+};
+
+// Halves the rate of a signal, with the same structure as the upsampler
+template <typename sample_t>
+struct half_band_downsampler
+{
+  void init(int32_t order, int32_t max_frames)
+  {
+    this->order = order;
+    taps = 2 * order + 2;
+    coefficients = std::make_unique<sample_t[]>(taps);
+    detail::design_half_band(order, 1., coefficients.get());
+    odd = std::make_unique<sample_t[]>(taps - 1 + max_frames);
+    even = std::make_unique<sample_t[]>(order + max_frames);
+  }
+
+  void reset() noexcept
+  {
+    std::fill_n(odd.get(), taps - 1, sample_t(0));
+    std::fill_n(even.get(), order, sample_t(0));
+  }
+
+  // Reads 2 * frames samples. out may be in.
+  void process(const sample_t* in, sample_t* out, int32_t frames) noexcept
+  {
+    sample_t* o = odd.get();
+    sample_t* e = even.get();
+    for (int32_t k = 0; k < frames; k++)
+    {
+      e[order + k] = in[2 * k];
+      o[taps - 1 + k] = in[2 * k + 1];
+    }
+
+    for (int32_t k = 0; k < frames; k++)
+      out[k] = sample_t(0.5) * e[k];
+    for (int32_t t = 0; t < taps; t++)
+    {
+      const sample_t c = coefficients[t];
+      const sample_t* window = o + t;
+      for (int32_t k = 0; k < frames; k++)
+        out[k] += c * window[k];
+    }
+
+    std::copy_n(o + frames, taps - 1, o);
+    std::copy_n(e + frames, order, e);
+  }
+
+  int32_t order{};
+  int32_t taps{};
+  std::unique_ptr<sample_t[]> coefficients;
+  std::unique_ptr<sample_t[]> odd;
+  std::unique_ptr<sample_t[]> even;
+};
+
+// Runs a signal at 2, 4 or 8 times its rate through cascaded half-band
+// stages. The first stage, at the lowest rate, has the steepest filter; the
+// following ones only have to reject the images above the audio band.
+//
+// All the memory is allocated by init(), which must not be called from the
+// audio thread. Blocks are at most max_frames long.
+template <typename sample_t>
+struct oversampler
+{
+  static constexpr int32_t max_stages = 3;
+  static constexpr int32_t orders[max_stages]{11, 5, 3};
+
+  void init(int32_t factor, int32_t channels, int32_t max_frames)
+  {
+    stages = std::countr_zero(uint32_t(factor));
+    this->channels = channels;
+    this->max_frames = max_frames;
+
+    up = std::make_unique<half_band_upsampler<sample_t>[]>(channels * stages);
+    down = std::make_unique<half_band_downsampler<sample_t>[]>(
+        channels * stages);
+    for (int32_t c = 0; c < channels; c++)
+      for (int32_t s = 0; s < stages; s++)
+      {
+        up[c * stages + s].init(orders[s], max_frames << s);
+        down[c * stages + s].init(orders[s], max_frames << s);
+      }
+
+    high_inputs
+        = std::make_unique<sample_t[]>(channels * (max_frames << stages));
+    high_outputs
+        = std::make_unique<sample_t[]>(channels * (max_frames << stages));
+  }
+
+  void reset() noexcept
+  {
+    for (int32_t i = 0; i < channels * stages; i++)
+    {
+      up[i].reset();
+      down[i].reset();
+    }
+  }
+
+  int32_t factor() const noexcept { return 1 << stages; }
+
+  // Delay of a round trip, in frames of the base rate
+  int32_t latency() const noexcept
+  {
+    double frames = 0.;
+    for (int32_t s = 0; s < stages; s++)
+      frames += double(2 * orders[s] + 1) / (1 << s);
+    return int32_t(std::lround(frames));
+  }
+
+  // Buffers at the high rate, for the processing of a channel
+  sample_t* input(int32_t channel) noexcept
+  {
+    return high_inputs.get() + channel * (max_frames << stages);
+  }
+  sample_t* output(int32_t channel) noexcept
+  {
+    return high_outputs.get() + channel * (max_frames << stages);
+  }
+
+  // Fills input(channel) with frames * factor() samples
+  void upsample(int32_t channel, const sample_t* in, int32_t frames) noexcept
+  {
+    sample_t* buffer = input(channel);
+    up[channel * stages].process(in, buffer, frames);
+    for (int32_t s = 1; s < stages; s++)
+      up[channel * stages + s].process(buffer, buffer, frames << s);
+  }
+
+  // Reads frames * factor() samples from output(channel)
+  void downsample(int32_t channel, sample_t* out, int32_t frames) noexcept
+  {
+    sample_t* buffer = output(channel);
+    for (int32_t s = stages - 1; s > 0; s--)
+      down[channel * stages + s].process(buffer, buffer, frames << s);
+    down[channel * stages].process(buffer, out, frames);
+  }
+
+  int32_t stages{};
+  int32_t channels{};
+  int32_t max_frames{};
+  std::unique_ptr<half_band_upsampler<sample_t>[]> up;
+  std::unique_ptr<half_band_downsampler<sample_t>[]> down;
+  std::unique_ptr<sample_t[]> high_inputs;
+  std::unique_ptr<sample_t[]> high_outputs;
+};
+
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/dsp/fast_math.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cmath>
+#include <memory>
+
+namespace vintage::dsp
+{
+
+enum class waveform
+{
+  sine,
+  triangle,
+  saw,
+  square
+};
+
+enum class interpolation
+{
+  linear,
+  cubic
+};
+
+// Band-limited wavetable with one mip level per octave.
+//
+// Level k holds the harmonics up to (Size / 2) >> k: level 0 is suitable
+// for the lowest notes, the last level is a pure sine. The level is chosen
+// from the phase increment (frequency / sample rate), which means that the
+// tables do not depend on the sample rate and can be shared by every voice
+// and every instance: see shared_wavetable().
+template <int32_t Size = 2048, int32_t Levels = 11>
+struct wavetable
+{
+  static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+  static_assert((Size / 2) >> (Levels - 1) >= 1, "Too many levels");
+
+  static constexpr int32_t size = Size;
+  static constexpr int32_t levels = Levels;
+
+  // One guard sample before and two after each table, for interpolation
+  static constexpr int32_t stride = Size + 3;
+
+  // Additive synthesis, done outside of the audio thread
+  void build(waveform w)
+  {
+    constexpr double pi = 3.141592653589793238462643383279502884;
+
+    // All the partials are read from a single-cycle sine, which is exact
+    // as harmonics fall on multiples of the sampling interval
+    auto sine = std::make_unique<double[]>(Size);
+    for (int32_t i = 0; i < Size; i++)
+      sine[i] = std::sin(2. * pi * i / Size);
+
+    auto accum = std::make_unique<double[]>(Size);
+    for (int32_t level = 0; level < Levels; level++)
+    {
+      const int32_t harmonics = (Size / 2) >> level;
+      std::fill_n(accum.get(), Size, 0.);
+
+      for (int32_t h = 1; h <= harmonics; h++)
+      {
+        double amplitude = 0.;
+        switch (w)
+        {
+          case waveform::sine:
+            amplitude = h == 1 ? 1. : 0.;
+            break;
+          case waveform::saw:
+            amplitude = (h % 2 ? 2. : -2.) / (pi * h);
+            break;
+          case waveform::square:
+            amplitude = h % 2 ? 4. / (pi * h) : 0.;
+            break;
+          case waveform::triangle:
+            // Odd harmonics with alternating signs
+            amplitude = h % 2 ? 8. / (pi * pi * h * h) : 0.;
+            amplitude *= (h / 2) % 2 ? -1. : 1.;
+            break;
+        }
+        if (amplitude == 0.)
+          continue;
+
+        for (int32_t i = 0; i < Size; i++)
+          accum[i] += amplitude * sine[(int64_t(h) * i) & (Size - 1)];
+      }
+
+      float* table = data.get() + level * stride + 1;
+      for (int32_t i = 0; i < Size; i++)
+        table[i] = accum[i];
+      table[-1] = table[Size - 1];
+      table[Size] = table[0];
+      table[Size + 1] = table[1];
+    }
+  }
+
+  // Level to use for a given increment in cycles per sample, such that no
+  // harmonic goes past Nyquist
+  int32_t level_for(float increment) const noexcept
+  {
+    const float octave = fast_log2(std::max(increment * Size, 1.f));
+    return std::min(int32_t(std::ceil(octave)), Levels - 1);
+  }
+
+  // index is in [0; Size), frac in [0; 1)
+  template <interpolation Interp = interpolation::linear>
+  float read(int32_t level, int32_t index, float frac) const noexcept
+  {
+    const float* t = data.get() + level * stride + 1 + index;
+    if constexpr (Interp == interpolation::linear)
+    {
+      return t[0] + frac * (t[1] - t[0]);
+    }
+    else
+    {
+      // Catmull-Rom spline
+      const float a = t[-1], b = t[0], c = t[1], d = t[2];
+      return b
+             + 0.5f * frac
+                   * (c - a
+                      + frac
+                            * (2.f * a - 5.f * b + 4.f * c - d
+                               + frac * (3.f * (b - c) + d - a)));
+    }
+  }
+
+  std::unique_ptr<float[]> data = std::make_unique<float[]>(Levels * stride);
+};
+
+// Tables built on first use and shared for the lifetime of the process.
+// Call it once outside of the audio thread (e.g. in a constructor) so that
+// the audio thread never pays for building them.
+template <waveform W, int32_t Size = 2048, int32_t Levels = 11>
+const wavetable<Size, Levels>& shared_wavetable()
+{
+  static const wavetable<Size, Levels> table = []
+  {
+    wavetable<Size, Levels> t;
+    t.build(W);
+    return t;
+  }();
+  return table;
+}
+
+// Oscillator reading a wavetable with a 32-bit fixed-point phase
+// accumulator: the phase wraps by integer overflow and keeps the same
+// precision however long the note lasts.
+template <int32_t Size = 2048, int32_t Levels = 11>
+struct wavetable_oscillator
+{
+  using table_type = wavetable<Size, Levels>;
+  static constexpr int32_t index_bits = std::countr_zero(uint32_t(Size));
+  static constexpr int32_t frac_bits = 32 - index_bits;
+
+  const table_type* table{};
+  uint32_t phase{};
+  uint32_t increment{};
+  int32_t level{};
+
+  void set_frequency(float frequency, float sample_rate) noexcept
+  {
+    const double cycles = std::clamp(double(frequency) / sample_rate, 0., 0.5);
+    increment = uint32_t(cycles * 4294967296. + 0.5);
+    level = table->level_for(cycles);
+  }
+
+  template <interpolation Interp = interpolation::linear>
+  float process() noexcept
+  {
+    const int32_t index = phase >> frac_bits;
+    const float frac
+        = float(phase & ((uint32_t(1) << frac_bits) - 1))
+          * (1.f / float(uint32_t(1) << frac_bits));
+    phase += increment;
+    return table->template read<Interp>(level, index, frac);
+  }
+};
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace vintage
+{
+
+// Fixed-capacity list of the events received for the upcoming block,
+// kept sorted by deltaFrames. Events with the same offset keep their arrival
+// order. Hosts generally send events in order, in which case push() is O(1).
+//
+// It is filled by ProcessEvents and consumed by process(), which the host
+// calls from the same thread, thus no synchronization is needed.
+template <typename Event, int32_t Capacity>
+struct event_buffer
+{
+  static constexpr int32_t capacity = Capacity;
+
+  // Returns false if the buffer is full
+  bool push(const Event& e) noexcept
+  {
+    if (count == Capacity)
+      return false;
+
+    int32_t i = count++;
+    while (i > 0 && events[i - 1].deltaFrames > e.deltaFrames)
+    {
+      events[i] = events[i - 1];
+      --i;
+    }
+    events[i] = e;
+    return true;
+  }
+
+  void clear() noexcept { count = 0; }
+
+  // Removes the first n events
+  void pop_front(int32_t n) noexcept
+  {
+    std::copy(events + n, events + count, events);
+    count -= n;
+  }
+
+  const Event* begin() const noexcept { return events; }
+  const Event* end() const noexcept { return events + count; }
+  int32_t size() const noexcept { return count; }
+  bool empty() const noexcept { return count == 0; }
+
+  Event events[Capacity]{};
+  int32_t count{};
+};
+
+}
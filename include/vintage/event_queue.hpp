@@ -0,0 +1,91 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <atomic>
+#include <cinttypes>
+
+namespace vintage
+{
+
+// Bounded queue carrying events to the audio thread, without locks nor
+// allocations.
+//
+// Hosts may call e.g. setParameter from both their audio and UI threads,
+// thus any number of threads can push; only the audio thread pops.
+// With a single producer, push() is wait-free. This is D. Vyukov's bounded
+// queue: each cell holds a sequence number telling whether it is free for
+// the producer of a given position, or ready for the consumer.
+template <typename Event, int32_t Capacity>
+struct event_queue
+{
+  static_assert(
+      Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+      "Capacity must be a power of two");
+  static constexpr int32_t capacity = Capacity;
+
+  event_queue() noexcept
+  {
+    for (uint32_t i = 0; i < uint32_t(Capacity); i++)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  // Returns false if the queue is full
+  bool push(const Event& e) noexcept
+  {
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell& c = cells[pos & mask];
+      const uint32_t seq = c.sequence.load(std::memory_order_acquire);
+      const int32_t diff = int32_t(seq - pos);
+      if (diff == 0)
+      {
+        if (head.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+        {
+          c.event = e;
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false;
+      }
+      else
+      {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer side. Returns false if the queue is empty
+  bool pop(Event& e) noexcept
+  {
+    cell& c = cells[tail & mask];
+    const uint32_t seq = c.sequence.load(std::memory_order_acquire);
+    if (int32_t(seq - (tail + 1)) < 0)
+      return false;
+
+    e = c.event;
+    c.sequence.store(tail + Capacity, std::memory_order_release);
+    ++tail;
+    return true;
+  }
+
+private:
+  static constexpr uint32_t mask = Capacity - 1;
+
+  struct cell
+  {
+    std::atomic<uint32_t> sequence;
+    Event event;
+  };
+
+  alignas(64) std::atomic<uint32_t> head{};
+  alignas(64) uint32_t tail{};
+  alignas(64) cell cells[Capacity];
+};
+
+}
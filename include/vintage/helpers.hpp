@@ -2,6 +2,12 @@
 
 /* SPDX-License-Identifier: AGPL-3.0-or-later */
 
+#include <vintage/denormals.hpp>
+#include <vintage/event_queue.hpp>
+#include <vintage/instrumentation.hpp>
+#include <vintage/preset_bank.hpp>
+#include <vintage/trace.hpp>
+#include <vintage/triple_buffer.hpp>
 #include <vintage/vintage.hpp>
 
 #include <boost/pfr.hpp>
@@ -9,7 +15,10 @@
 #include <math.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
+#include <memory>
 #include <set>
 
 #include <string_view>
@@ -76,6 +85,45 @@ void for_nth_parameter(Parameters& params, int n, F&& func) noexcept
   (std::make_index_sequence<boost::pfr::tuple_size_v<Parameters>>());
 }
 
+// Applies the queued events up to the given offsets, in the order process()
+// would: on a given frame, parameters before MIDI. Makes room in the queues
+// of the effect when a block has more events than they hold.
+template <typename Effect>
+void apply_events_until(
+    Effect& eff,
+    int32_t parameter_offset,
+    int32_t midi_offset)
+{
+  auto& params = eff.parameter_events;
+  auto param = params.begin();
+  if constexpr (requires { eff.midi_events; })
+  {
+    auto& midis = eff.midi_events;
+    auto midi = midis.begin();
+    for (;;)
+    {
+      const bool has_param
+          = param != params.end() && param->deltaFrames <= parameter_offset;
+      const bool has_midi
+          = midi != midis.end() && midi->deltaFrames <= midi_offset;
+      if (has_param
+          && (!has_midi || param->deltaFrames <= midi->deltaFrames))
+        eff.controls.apply(eff.implementation, *param++);
+      else if (has_midi)
+        eff.midi_input(*midi++);
+      else
+        break;
+    }
+    midis.pop_front(int32_t(midi - midis.begin()));
+  }
+  else
+  {
+    while (param != params.end() && param->deltaFrames <= parameter_offset)
+      eff.controls.apply(eff.implementation, *param++);
+  }
+  params.pop_front(int32_t(param - params.begin()));
+}
+
 template <typename Effect>
 intptr_t default_dispatch(
     Effect& eff,
@@ -86,12 +134,25 @@ intptr_t default_dispatch(
     float opt)
 {
   auto& self = eff.implementation;
-  // std::cerr << int(opcode) << ": " << index << " ; " << value << " ;" << ptr
-  //           << " ;" << opt << std::endl;
+  [[maybe_unused]] trace_scope trace{
+      &eff, trace_kind::dispatch, int32_t(opcode), index, value, opt};
   switch (opcode)
   {
     case EffectOpcodes::Identify: // 22
       return 0;
+#if defined(VINTAGE_INSTRUMENTATION)
+    case EffectOpcodes::VendorSpecific: // 50
+    {
+      // Answers the magic only after filling the host's pointer
+      if (index == instrumentation_block::magic && ptr)
+      {
+        *static_cast<instrumentation_block**>(ptr)
+            = &eff.processor.stats.block();
+        return instrumentation_block::magic;
+      }
+      return 0;
+    }
+#endif
     case EffectOpcodes::SetProcessPrecision: // 77
     {
       if constexpr (requires
@@ -104,20 +165,32 @@ intptr_t default_dispatch(
     {
       if constexpr (requires { self.sample_rate = 44100; })
         self.sample_rate = opt;
+#if defined(VINTAGE_INSTRUMENTATION)
+      eff.processor.stats.block().sample_rate.store(opt);
+#endif
       if constexpr (requires { self.buffer_size = 512; })
         self.buffer_size = value;
+      if constexpr (requires { eff.prepare(int32_t{}); })
+        eff.prepare(value);
+      eff.processor.prepare(value);
       return 1;
     }
     case EffectOpcodes::SetSampleRate: // 10
     {
       if constexpr (requires { self.sample_rate = 44100; })
         self.sample_rate = opt;
+#if defined(VINTAGE_INSTRUMENTATION)
+      eff.processor.stats.block().sample_rate.store(opt);
+#endif
       return 1;
     }
     case EffectOpcodes::SetBlockSize: // 11
     {
       if constexpr (requires { self.buffer_size = 512; })
         self.buffer_size = value;
+      if constexpr (requires { eff.prepare(int32_t{}); })
+        eff.prepare(value);
+      eff.processor.prepare(value);
       return 1;
     }
     case EffectOpcodes::Open: // 0
@@ -139,6 +212,11 @@ intptr_t default_dispatch(
 
     case EffectOpcodes::GetProgram: // 3
     {
+      if constexpr (requires { eff.programs.bank; })
+      {
+        if (eff.programs.bank.size() > 0)
+          return eff.programs.current;
+      }
       if constexpr (requires { self.current_program; })
       {
         return self.current_program;
@@ -148,13 +226,21 @@ intptr_t default_dispatch(
 
     case EffectOpcodes::SetProgram: // 2
     {
+      if constexpr (requires { eff.programs.bank; })
+      {
+        if (eff.programs.bank.size() > 0)
+        {
+          if (eff.programs.select(eff, value))
+            eff.request(HostOpcodes::UpdateDisplay, 0, 0, nullptr, 0.f);
+          return 0;
+        }
+      }
       if constexpr (requires { self.current_program; })
       {
         if (value < std::ssize(self.programs))
         {
           self.current_program = value;
-          self.parameters = self.programs[value].parameters;
-          eff.controls.write(eff.implementation);
+          eff.controls.stage(self.programs[value].parameters);
           eff.request(HostOpcodes::UpdateDisplay, 0, 0, nullptr, 0.f);
         }
         else
@@ -184,6 +270,11 @@ intptr_t default_dispatch(
     }
     case EffectOpcodes::MainsChanged: // 12
     {
+      if constexpr (requires { eff.reset(); })
+      {
+        if (value == 0)
+          eff.reset();
+      }
       return 0;
     }
     case EffectOpcodes::StartProcess: // 71
@@ -200,6 +291,15 @@ intptr_t default_dispatch(
     case EffectOpcodes::StopProcess: // 72
       return 1;
 
+    case EffectOpcodes::GetTailSize: // 52
+    {
+      // 0 lets the host pick a default, 1 means no tail. Same length as the
+      // idle detection waits for, latency included.
+      if constexpr (requires { eff.tail_length(); })
+        return std::max<intptr_t>(eff.tail_length(), 1);
+      return 0;
+    }
+
     case EffectOpcodes::GetInputProperties: // 33
       return 0;
     case EffectOpcodes::GetOutputProperties: // 34
@@ -265,6 +365,14 @@ intptr_t default_dispatch(
 
     case EffectOpcodes::GetProgramName: // 5
     {
+      if constexpr (requires { eff.programs.bank; })
+      {
+        if (eff.programs.bank.size() > 0)
+        {
+          eff.programs.name(eff.programs.current, ptr);
+          return 1;
+        }
+      }
       if constexpr (
           requires { self.current_program; }
           && requires { std::ssize(self.programs); })
@@ -281,6 +389,14 @@ intptr_t default_dispatch(
 
     case EffectOpcodes::GetProgramNameIndexed: // 29
     {
+      if constexpr (requires { eff.programs.bank; })
+      {
+        if (eff.programs.bank.size() > 0)
+        {
+          eff.programs.name(index, ptr);
+          return 1;
+        }
+      }
       if constexpr (requires { std::ssize(self.programs); })
       {
         if (index < std::ssize(self.programs))
@@ -312,27 +428,90 @@ intptr_t default_dispatch(
 
     case EffectOpcodes::ProcessEvents:
     {
-      if constexpr (requires {
-                      eff.midi_input(
-                          std::declval<const vintage::MidiEvent&>());
-                    })
+      auto evs = reinterpret_cast<const vintage::Events*>(ptr);
+      for (int32_t i = 0, n = evs->numEvents; i < n; i++)
       {
-        auto evs = reinterpret_cast<const vintage::Events*>(ptr);
-        for (int32_t i = 0, n = evs->numEvents; i < n; i++)
+        const auto* ev = evs->events[i];
+        switch (ev->type)
         {
-          const auto* ev = evs->events[i];
-          switch (ev->type)
+          case vintage::EventTypes::Midi:
           {
-            case vintage::EventTypes::Midi:
-              eff.midi_input(*reinterpret_cast<const vintage::MidiEvent*>(ev));
-              break;
-            default:
-              break;
+            if constexpr (requires {
+                            eff.midi_input(
+                                std::declval<const vintage::MidiEvent&>());
+                          })
+            {
+              const auto& midi
+                  = *reinterpret_cast<const vintage::MidiEvent*>(ev);
+              trace_midi(&eff, midi);
+
+              // Effects which render sub-blocks apply the events at their
+              // offset during process(). If the block has too many events,
+              // the ones up to this one are applied right away to make
+              // room, in order, so that e.g. no note-off precedes its
+              // note-on.
+              if constexpr (requires { eff.midi_events.push(midi); })
+              {
+                if (eff.midi_events.push(midi))
+                  break;
+                apply_events_until(eff, midi.deltaFrames, midi.deltaFrames);
+                if (eff.midi_events.push(midi))
+                  break;
+              }
+              eff.midi_input(midi);
+            }
+            break;
+          }
+          case vintage::EventTypes::Parameter:
+          {
+            const auto& param
+                = *reinterpret_cast<const vintage::ParameterEvent*>(ev);
+
+            // Automation points are applied at their offset during
+            // process(), making room as for MIDI events; the ones which
+            // target parameters handled by the wrapper are set right away.
+            if constexpr (requires { eff.parameter_events.push(param); })
+            {
+              if (param.index >= 0
+                  && param.index < eff.controls.parameter_count)
+              {
+                if (eff.parameter_events.push(param))
+                  break;
+                apply_events_until(
+                    eff, param.deltaFrames, param.deltaFrames - 1);
+                if (eff.parameter_events.push(param))
+                  break;
+                eff.controls.apply(eff.implementation, param);
+                break;
+              }
+            }
+            eff.Effect::setParameter(&eff, param.index, param.value);
+            break;
           }
+          default:
+            break;
         }
       }
       return 1;
     }
+    case EffectOpcodes::GetChunk: // 23
+    {
+      if constexpr (requires { eff.chunks; })
+        return eff.chunks.get(eff, static_cast<void**>(ptr));
+      return 0;
+    }
+    case EffectOpcodes::SetChunk: // 24
+    {
+      if constexpr (requires { eff.chunks; })
+      {
+        if (eff.chunks.set(eff, ptr, value))
+        {
+          eff.request(HostOpcodes::UpdateDisplay, 0, 0, nullptr, 0.f);
+          return 1;
+        }
+      }
+      return 0;
+    }
     case EffectOpcodes::GetVendorVersion: // 49
       return self.version;
     case EffectOpcodes::GetApiVersion: // 58
@@ -356,6 +535,13 @@ intptr_t default_dispatch(
                    ? 1
                    : 0;
       }
+      else if constexpr (requires { eff.parameter_events; })
+      {
+        return std::string_view{reinterpret_cast<const char*>(ptr)}
+                       == "receiveVstEvents"
+                   ? 1
+                   : 0;
+      }
       /*
       "sendVstEvents";
       "sendVstMidiEvent";
@@ -370,13 +556,58 @@ intptr_t default_dispatch(
   return 0;
 }
 
+// Parameters as seen by the host.
+//
+// setParameter may be called from any thread: it stores the value in an
+// atomic, for getParameter, and queues it for the audio thread. At the start
+// of each block, the queue is applied in order, so that no intermediate value
+// is lost, e.g. for a button pressed and released between two blocks.
+// If the queue overflows, parameters are flagged as changed instead and
+// write() copies the flagged ones.
+//
+// Programs are staged whole and applied before the queue. Each program bumps
+// an epoch which stamps the queued values: those set before the program
+// change are dropped rather than applied over it.
+//
+// Whenever a value moves, the implementation's on_change(param) hook, if
+// any, is called, e.g.:
+//
+//   void on_change(const decltype(parameters.preamp)& p) { gain = ...; }
+//
+// or a single on_change(const auto& param) for every parameter.
 template <typename T>
 struct Controls
 {
   static const constexpr int32_t parameter_count
       = boost::pfr::tuple_size_v<decltype(T::parameters)>;
+  static const constexpr int32_t changed_words = (parameter_count + 63) / 64;
+
   std::atomic<float> parameters[parameter_count];
 
+  // One bit per parameter, set by the host and cleared by write()
+  std::atomic<uint64_t> changed[std::max(changed_words, 1)]{};
+
+  struct queued_value
+  {
+    int32_t index{};
+    float value{};
+    uint32_t epoch{};
+  };
+
+  struct staged_program
+  {
+    decltype(T::parameters) values{};
+    uint32_t epoch{};
+  };
+
+  event_queue<queued_value, 1024> queue;
+  triple_buffer<staged_program> staged;
+
+  // Bumped by stage(), on the dispatcher thread
+  std::atomic<uint32_t> epoch{};
+  // Epoch of the latest program applied by write(), on the audio thread
+  uint32_t applied_epoch{};
+
   template <typename Effect_T>
   void init(Effect_T& effect)
   {
@@ -385,50 +616,113 @@ struct Controls
     {
       auto& self = *static_cast<Effect_T*>(effect);
 
-      if (index < Controls<T>::parameter_count)
-        self.controls.parameters[index].store(
-            parameter, std::memory_order_release);
+      if (index >= 0 && index < Controls<T>::parameter_count)
+        self.controls.set(index, parameter);
     };
 
     effect.Effect::getParameter = [](Effect* effect, int32_t index) noexcept
     {
       auto& self = *static_cast<Effect_T*>(effect);
 
-      if (index < Controls<T>::parameter_count)
+      if (index >= 0 && index < Controls<T>::parameter_count)
         return self.controls.parameters[index].load(std::memory_order_acquire);
       else
         return 0.f;
     };
   }
 
-  void read(const T& implementation)
+  void set(int32_t index, float value) noexcept
   {
-    [ this, &implementation ]<std::size_t... Index>(
+    parameters[index].store(value, std::memory_order_relaxed);
+    const uint32_t e = epoch.load(std::memory_order_acquire);
+    if (!queue.push({.index = index, .value = value, .epoch = e}))
+      changed[index / 64].fetch_or(
+          uint64_t(1) << (index % 64), std::memory_order_release);
+  }
+
+  // Applies an automation point received with ProcessEvents, when
+  // process() reaches its frame
+  void apply(T& implementation, const ParameterEvent& event)
+  {
+    parameters[event.index].store(event.value, std::memory_order_relaxed);
+    updaters[event.index](implementation, event.value);
+  }
+
+  // Mirrors a set of parameters in the values returned by getParameter
+  void read(const decltype(T::parameters)& source)
+  {
+    [ this, &source ]<std::size_t... Index>(
         std::integer_sequence<std::size_t, Index...>)
     {
       auto& sink = this->parameters;
-      auto& source = implementation.parameters;
       (sink[Index].store(
            boost::pfr::get<Index>(source).value, std::memory_order_relaxed),
        ...);
     }
     (std::make_index_sequence<parameter_count>());
+  }
+
+  // Loads a whole set of parameters, e.g. a program, from the dispatcher
+  // thread. The audio thread picks it up at the start of the next block,
+  // all at once.
+  void stage(const decltype(T::parameters)& source)
+  {
+    read(source);
+    const uint32_t e = epoch.load(std::memory_order_relaxed) + 1;
+    staged.back() = {.values = source, .epoch = e};
+    staged.publish();
 
-    std::atomic_thread_fence(std::memory_order_release);
+    // Published first: a value stamped with the new epoch is always queued
+    // after the program is visible
+    epoch.store(e, std::memory_order_release);
   }
 
+  // Applies the values set by the host since the previous call
   void write(T& implementation)
   {
-    std::atomic_thread_fence(std::memory_order_acquire);
+    apply_staged(implementation);
 
-    [ this, &implementation ]<std::size_t... Index>(
+    // Then the values set since the program change
+    queued_value event;
+    while (queue.pop(event))
+    {
+      // Set after a program staged during this loop
+      if (int32_t(event.epoch - applied_epoch) > 0)
+        apply_staged(implementation);
+      // Set before the current program
+      if (int32_t(event.epoch - applied_epoch) < 0)
+        continue;
+      updaters[event.index](implementation, event.value);
+    }
+
+    // The values which did not fit in the queue are the most recent ones
+    for (int32_t w = 0; w < changed_words; w++)
+    {
+      // Skip the read-modify-write in the common case where nothing changed
+      if (changed[w].load(std::memory_order_relaxed) == 0)
+        continue;
+
+      uint64_t bits = changed[w].exchange(0, std::memory_order_acquire);
+      while (bits != 0)
+      {
+        const int32_t index = w * 64 + std::countr_zero(bits);
+        bits &= bits - 1;
+        if (index < parameter_count)
+          updaters[index](
+              implementation,
+              parameters[index].load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  // Calls the change hook of every parameter, to initialize derived state
+  void notify(T& implementation)
+  {
+    [&implementation]<std::size_t... Index>(
         std::integer_sequence<std::size_t, Index...>)
     {
-      auto& source = this->parameters;
-      auto& sink = implementation.parameters;
-      ((boost::pfr::get<Index>(sink).value
-        = source[Index].load(std::memory_order_relaxed)),
-       ...);
+      auto& params = implementation.parameters;
+      (notify_one(implementation, boost::pfr::get<Index>(params)), ...);
     }
     (std::make_index_sequence<parameter_count>());
   }
@@ -492,6 +786,50 @@ struct Controls
           }
         });
   }
+
+private:
+  // The latest program staged, if not applied yet
+  void apply_staged(T& implementation)
+  {
+    if (!staged.consume())
+      return;
+
+    const staged_program& program = staged.front();
+    [&implementation, &source = program.values]<std::size_t... Index>(
+        std::integer_sequence<std::size_t, Index...>)
+    {
+      (update<Index>(implementation, boost::pfr::get<Index>(source).value),
+       ...);
+    }
+    (std::make_index_sequence<parameter_count>());
+    applied_epoch = program.epoch;
+  }
+
+  static void notify_one(T& implementation, auto& param)
+  {
+    if constexpr (requires { implementation.on_change(param); })
+      implementation.on_change(param);
+  }
+
+  template <std::size_t Index>
+  static void update(T& implementation, float value)
+  {
+    auto& param = boost::pfr::get<Index>(implementation.parameters);
+    if (param.value != value)
+    {
+      param.value = value;
+      notify_one(implementation, param);
+    }
+  }
+
+  // Maps an index to the code updating the corresponding member
+  using updater = void (*)(T&, float);
+  static constexpr auto updaters =
+      []<std::size_t... Index>(std::integer_sequence<std::size_t, Index...>)
+  {
+    return std::array<updater, parameter_count>{&update<Index>...};
+  }
+  (std::make_index_sequence<parameter_count>());
 };
 
 template <typename T>
@@ -507,15 +845,14 @@ struct SynthControls : Controls<T>
     effect.Effect::setParameter
         = [](Effect* effect, int32_t index, float parameter) noexcept
     {
-      if (index < Controls<T>::parameter_count + 3)
+      if (index >= 0 && index < Controls<T>::parameter_count + 3)
       {
         auto& self = *static_cast<Effect_T*>(effect);
 
         switch (index)
         {
           default:
-            self.controls.parameters[index].store(
-                parameter, std::memory_order_release);
+            self.controls.set(index, parameter);
             break;
           case Controls<T>::parameter_count:
             self.controls.unison_voices.store(
@@ -535,7 +872,7 @@ struct SynthControls : Controls<T>
 
     effect.Effect::getParameter = [](Effect* effect, int32_t index) noexcept
     {
-      if (index < Controls<T>::parameter_count + 3)
+      if (index >= 0 && index < Controls<T>::parameter_count + 3)
       {
         auto& self = *static_cast<Effect_T*>(effect);
 
@@ -634,6 +971,17 @@ struct SynthControls : Controls<T>
 template <typename T>
 struct Programs
 {
+  // Programs come from the implementation's programs array, unless it
+  // declares a preset bank file, e.g.
+  //
+  //   static constexpr auto bank_file = "/usr/share/foo/factory.fxb";
+  //
+  // which takes precedence when it can be opened. Programs of the bank are
+  // only read when they are selected.
+  preset_bank bank;
+  int32_t current{};
+
+  // Called once the controls are initialized
   template <typename Effect_T>
   void init(Effect_T& effect)
   {
@@ -641,7 +989,63 @@ struct Programs
     {
       effect.Effect::numPrograms = std::size(effect.implementation.programs);
     }
+
+    if constexpr (requires { T::bank_file; })
+    {
+      if (bank.open(T::bank_file, T::unique_id))
+      {
+        if (bank.size() > 0)
+        {
+          effect.Effect::numPrograms = bank.size();
+          select(effect, bank.current());
+        }
+        else if constexpr (requires { effect.chunks; })
+        {
+          effect.chunks.set(effect, bank.chunk(), bank.chunk_size());
+        }
+      }
+    }
   }
+
+  // Loads a program of the bank. Returns false if there is no bank or the
+  // program cannot be read.
+  template <typename Effect_T>
+  bool select(Effect_T& effect, int32_t index)
+  {
+    constexpr int32_t count = Controls<T>::parameter_count;
+    auto& controls = effect.controls;
+
+    // Parameters missing from the program keep their current value
+    float values[count];
+    for (int32_t i = 0; i < count; i++)
+      values[i] = controls.parameters[i].load(std::memory_order_relaxed);
+    if (!bank.read(index, values, count))
+      return false;
+
+    [this, &values]<std::size_t... Index>(
+        std::integer_sequence<std::size_t, Index...>)
+    {
+      ((boost::pfr::get<Index>(staged).value = values[Index]), ...);
+    }
+    (std::make_index_sequence<count>());
+    controls.stage(staged);
+
+    current = index;
+    if constexpr (requires { effect.implementation.current_program; })
+      effect.implementation.current_program = index;
+    return true;
+  }
+
+  // Copies the name of a program of the bank, with its terminating zero
+  void name(int32_t index, void* ptr) const noexcept
+  {
+    const auto str = bank.name(index).substr(0, Constants::ProgNameLen - 1);
+    std::copy_n(str.data(), str.size(), static_cast<char*>(ptr));
+    static_cast<char*>(ptr)[str.size()] = '\0';
+  }
+
+private:
+  decltype(T::parameters) staged{};
 };
 
 template <typename FP, typename T>
@@ -655,6 +1059,19 @@ concept synth_processor = requires(T& t)
   std::declval<T::voice>().process(t, (FP**)nullptr, (int32_t)0);
 };
 
+// Implementations whose kernels are only efficient in float, e.g. because
+// twice as many samples fit in a SIMD register, declare
+//
+//   static constexpr bool single_precision = true;
+//
+// Double-precision hosts are then served by converting their buffers to
+// float and back around the float kernel, which is the only one compiled.
+template <typename T>
+concept single_precision_processor = requires
+{
+  requires T::single_precision;
+};
+
 template <typename T>
 struct Processor
 {
@@ -662,6 +1079,33 @@ struct Processor
   void init(Effect_T& effect)
   {
     auto& implementation = effect.implementation;
+
+#if defined(VINTAGE_INSTRUMENTATION)
+    stats.block().sample_rate.store(
+        effect.request(HostOpcodes::GetSampleRate, 0, 0, nullptr, 0.f));
+#endif
+
+    if constexpr (single_precision_processor<T>)
+    {
+      const int32_t frames
+          = effect.request(HostOpcodes::GetBlockSize, 0, 0, nullptr, 0.f);
+      prepare(frames > 0 ? frames : 4096);
+
+      effect.Effect::processDoubleReplacing = [](Effect* effect,
+                                                 double** inputs,
+                                                 double** outputs,
+                                                 int32_t sampleFrames)
+      {
+        auto& self = *static_cast<Effect_T*>(effect);
+        [[maybe_unused]] denormal_scope_for<T> denormals;
+        [[maybe_unused]] instrumentation_scope<Effect_T> timing{
+            self, sampleFrames};
+        [[maybe_unused]] trace_scope trace{
+            effect, trace_kind::process_double, sampleFrames};
+        return self.processor.process_in_float(
+            self, inputs, outputs, sampleFrames);
+      };
+    }
     if constexpr (
         effect_processor<float, Effect_T> || synth_processor<float, Effect_T>)
     {
@@ -671,6 +1115,11 @@ struct Processor
                                   int32_t sampleFrames)
       {
         auto& self = *static_cast<Effect_T*>(effect);
+        [[maybe_unused]] denormal_scope_for<T> denormals;
+        [[maybe_unused]] instrumentation_scope<Effect_T> timing{
+            self, sampleFrames};
+        [[maybe_unused]] trace_scope trace{
+            effect, trace_kind::process, sampleFrames};
         return self.process(inputs, outputs, sampleFrames);
       };
 
@@ -680,14 +1129,19 @@ struct Processor
                                            int32_t sampleFrames)
       {
         auto& self = *static_cast<Effect_T*>(effect);
+        [[maybe_unused]] denormal_scope_for<T> denormals;
+        [[maybe_unused]] instrumentation_scope<Effect_T> timing{
+            self, sampleFrames};
+        [[maybe_unused]] trace_scope trace{
+            effect, trace_kind::process, sampleFrames};
         return self.process(inputs, outputs, sampleFrames);
       };
     }
 
     if constexpr (
-        effect_processor<
-            double,
-            Effect_T> || synth_processor<double, Effect_T>)
+        !single_precision_processor<T>
+        && (effect_processor<double, Effect_T>
+            || synth_processor<double, Effect_T>))
     {
       effect.Effect::processDoubleReplacing = [](Effect* effect,
                                                  double** inputs,
@@ -695,10 +1149,70 @@ struct Processor
                                                  int32_t sampleFrames)
       {
         auto& self = *static_cast<Effect_T*>(effect);
+        [[maybe_unused]] denormal_scope_for<T> denormals;
+        [[maybe_unused]] instrumentation_scope<Effect_T> timing{
+            self, sampleFrames};
+        [[maybe_unused]] trace_scope trace{
+            effect, trace_kind::process_double, sampleFrames};
         return self.process(inputs, outputs, sampleFrames);
       };
     }
   }
+
+  // Called with the maximum block size, while processing is suspended
+  void prepare(int32_t max_frames)
+  {
+    if constexpr (single_precision_processor<T>)
+    {
+      if (max_frames <= capacity)
+        return;
+      capacity = max_frames;
+      scratch = std::make_unique<float[]>(2 * T::channels * capacity);
+    }
+  }
+
+  // Blocks longer than announced by the host are split, which moves the
+  // events of the later parts to their start
+  template <typename Effect_T>
+  void process_in_float(
+      Effect_T& self,
+      double** inputs,
+      double** outputs,
+      int32_t frames)
+  {
+    for (int32_t offset = 0; offset < frames; offset += capacity)
+    {
+      const int32_t n = std::min(capacity, frames - offset);
+      float* float_inputs[T::channels];
+      float* float_outputs[T::channels];
+      for (int32_t c = 0; c < T::channels; c++)
+      {
+        float_inputs[c] = scratch.get() + c * capacity;
+        float_outputs[c] = scratch.get() + (T::channels + c) * capacity;
+
+        const double* in = inputs[c] + offset;
+        for (int32_t i = 0; i < n; i++)
+          float_inputs[c][i] = float(in[i]);
+      }
+
+      self.process(float_inputs, float_outputs, n);
+
+      for (int32_t c = 0; c < T::channels; c++)
+      {
+        double* out = outputs[c] + offset;
+        for (int32_t i = 0; i < n; i++)
+          out[i] = float_outputs[c][i];
+      }
+    }
+  }
+
+#if defined(VINTAGE_INSTRUMENTATION)
+  instrumentation stats;
+#endif
+
+private:
+  std::unique_ptr<float[]> scratch;
+  int32_t capacity{};
 };
 
 }
@@ -0,0 +1,322 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <new>
+
+#if defined(VINTAGE_INSTRUMENTATION_SHM) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
+namespace vintage
+{
+
+// Statistics of the process calls of an instance.
+//
+// With VINTAGE_INSTRUMENTATION defined, the wrappers time every process
+// call: its duration goes to a histogram, and the duration, frames and
+// playing voices of the latest calls to a ring buffer. Calls which take
+// longer than the audio they render are counted as overruns.
+//
+// The audio thread is the only writer: it never waits nor allocates, and
+// updates the counters with plain atomic stores. Any other thread may read
+// them at any time; the records of the ring carry a sequence number so that
+// the torn ones are detected.
+//
+// Hosts reach the block of an instance with
+//
+//   instrumentation_block* block = nullptr;
+//   dispatcher(effect, VendorSpecific, instrumentation_block::magic, 0,
+//              &block, 0.f) == instrumentation_block::magic
+//
+// Plug-ins which do not know the request may return anything, but not the
+// magic: hosts never dereference the value returned.
+//
+// With VINTAGE_INSTRUMENTATION_SHM also defined, the block lives in a POSIX
+// shared-memory segment whose name it holds, to be read from another
+// process, e.g. with vintage-stats. All the members are lock-free atomics,
+// which are address-free.
+struct instrumentation_block
+{
+  static constexpr int32_t magic = 0x76737461; // 'vsta'
+  static constexpr int32_t version = 1;
+
+  // Durations in ns, with four buckets per octave up to about 8 s
+  static constexpr int32_t buckets = 128;
+  static constexpr int32_t ring_size = 1024;
+
+  static constexpr int32_t bucket(uint64_t ns) noexcept
+  {
+    if (ns < 4)
+      return int32_t(ns);
+    const int32_t msb = std::bit_width(ns) - 1;
+    const int32_t sub = int32_t(ns >> (msb - 2)) & 3;
+    return std::min(buckets - 1, 4 * (msb - 1) + sub);
+  }
+
+  // Shortest duration counted in a bucket
+  static constexpr uint64_t bucket_floor(int32_t b) noexcept
+  {
+    if (b < 4)
+      return uint64_t(b);
+    return uint64_t(4 + b % 4) << (b / 4 - 1);
+  }
+
+  struct record
+  {
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint32_t> duration_ns;
+    std::atomic<int32_t> frames;
+    std::atomic<int32_t> voices;
+  };
+
+  int32_t header{magic};
+  int32_t layout{version};
+  char name[64]{};
+
+  std::atomic<double> sample_rate{};
+  std::atomic<uint64_t> calls{};
+  std::atomic<uint64_t> frames{};
+  std::atomic<uint64_t> total_ns{};
+  std::atomic<uint64_t> max_ns{};
+  std::atomic<uint64_t> overruns{};
+  std::atomic<uint64_t> histogram[buckets]{};
+
+  // Index of the next record to be written
+  std::atomic<uint64_t> head{};
+  record ring[ring_size]{};
+
+  void add(uint64_t start, uint64_t ns, int32_t count, int32_t voices) noexcept
+  {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    const uint64_t n = calls.load(relaxed);
+    calls.store(n + 1, relaxed);
+    frames.store(frames.load(relaxed) + count, relaxed);
+    total_ns.store(total_ns.load(relaxed) + ns, relaxed);
+    if (ns > max_ns.load(relaxed))
+      max_ns.store(ns, relaxed);
+
+    const double rate = sample_rate.load(relaxed);
+    if (rate > 0. && double(ns) > count * 1e9 / rate)
+      overruns.store(overruns.load(relaxed) + 1, relaxed);
+
+    auto& h = histogram[bucket(ns)];
+    h.store(h.load(relaxed) + 1, relaxed);
+
+    // Odd while the record is being written
+    const uint64_t index = head.load(relaxed);
+    record& r = ring[index % ring_size];
+    r.sequence.store(2 * index + 1, relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    r.start_ns.store(start, relaxed);
+    r.duration_ns.store(uint32_t(std::min<uint64_t>(ns, UINT32_MAX)), relaxed);
+    r.frames.store(count, relaxed);
+    r.voices.store(voices, relaxed);
+    r.sequence.store(2 * index + 2, std::memory_order_release);
+    head.store(index + 1, std::memory_order_release);
+  }
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<double>::is_always_lock_free);
+
+// What a reader gets of a block
+struct instrumentation_snapshot
+{
+  struct call
+  {
+    uint64_t start_ns{};
+    uint32_t duration_ns{};
+    int32_t frames{};
+    int32_t voices{};
+  };
+
+  double sample_rate{};
+  uint64_t calls{};
+  uint64_t frames{};
+  uint64_t total_ns{};
+  uint64_t max_ns{};
+  uint64_t overruns{};
+  std::array<uint64_t, instrumentation_block::buckets> histogram{};
+
+  // Duration under which a fraction p of the calls ran, in ns, to the
+  // resolution of the histogram
+  uint64_t percentile(double p) const noexcept
+  {
+    uint64_t count = 0;
+    for (uint64_t h : histogram)
+      count += h;
+    const uint64_t target = uint64_t(p * count);
+    uint64_t seen = 0;
+    for (int32_t b = 0; b < instrumentation_block::buckets; b++)
+    {
+      seen += histogram[b];
+      if (seen > target)
+        return instrumentation_block::bucket_floor(b + 1);
+    }
+    return max_ns;
+  }
+
+  static instrumentation_snapshot read(const instrumentation_block& b)
+  {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    instrumentation_snapshot s;
+    s.sample_rate = b.sample_rate.load(relaxed);
+    s.calls = b.calls.load(relaxed);
+    s.frames = b.frames.load(relaxed);
+    s.total_ns = b.total_ns.load(relaxed);
+    s.max_ns = b.max_ns.load(relaxed);
+    s.overruns = b.overruns.load(relaxed);
+    for (int32_t i = 0; i < instrumentation_block::buckets; i++)
+      s.histogram[i] = b.histogram[i].load(relaxed);
+    return s;
+  }
+
+  // Copies up to count of the latest calls, oldest first; returns how many
+  static int32_t
+  recent(const instrumentation_block& b, call* out, int32_t count)
+  {
+    constexpr auto relaxed = std::memory_order_relaxed;
+    const uint64_t head = b.head.load(std::memory_order_acquire);
+    const uint64_t available = std::min<uint64_t>(
+        head, std::min(count, instrumentation_block::ring_size));
+
+    int32_t copied = 0;
+    for (uint64_t index = head - available; index < head; index++)
+    {
+      const auto& r = b.ring[index % instrumentation_block::ring_size];
+      const uint64_t before = r.sequence.load(std::memory_order_acquire);
+      call c{
+          .start_ns = r.start_ns.load(relaxed),
+          .duration_ns = r.duration_ns.load(relaxed),
+          .frames = r.frames.load(relaxed),
+          .voices = r.voices.load(relaxed)};
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Skips the records overwritten while they were read
+      if (before == 2 * index + 2 && r.sequence.load(relaxed) == before)
+        out[copied++] = c;
+    }
+    return copied;
+  }
+};
+
+#if defined(VINTAGE_INSTRUMENTATION)
+// Owns the block of an instance: on the heap, or in shared memory
+struct instrumentation
+{
+  instrumentation()
+  {
+#if defined(VINTAGE_INSTRUMENTATION_SHM) && !defined(_WIN32)
+    static std::atomic<int32_t> instances{};
+    char name[64];
+    std::snprintf(
+        name, sizeof(name), "/vintage.%d.%d", int(getpid()), instances++);
+
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd >= 0)
+    {
+      void* p = MAP_FAILED;
+      if (ftruncate(fd, sizeof(instrumentation_block)) == 0)
+        p = mmap(
+            nullptr,
+            sizeof(instrumentation_block),
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd,
+            0);
+      ::close(fd);
+
+      if (p != MAP_FAILED)
+      {
+        shared = new (p) instrumentation_block;
+        std::copy_n(name, sizeof(name), shared->name);
+        return;
+      }
+      shm_unlink(name);
+    }
+#endif
+    owned = std::make_unique<instrumentation_block>();
+  }
+
+  instrumentation(const instrumentation&) = delete;
+  instrumentation& operator=(const instrumentation&) = delete;
+
+  ~instrumentation()
+  {
+#if defined(VINTAGE_INSTRUMENTATION_SHM) && !defined(_WIN32)
+    if (shared)
+    {
+      shm_unlink(shared->name);
+      shared->~instrumentation_block();
+      munmap(shared, sizeof(instrumentation_block));
+    }
+#endif
+  }
+
+  instrumentation_block& block() noexcept
+  {
+    return shared ? *shared : *owned;
+  }
+
+  static uint64_t now() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  std::unique_ptr<instrumentation_block> owned;
+  instrumentation_block* shared{};
+};
+
+// Times a process call of the instance, for its lifetime
+template <typename Effect_T>
+struct instrumentation_scope
+{
+  instrumentation_scope(Effect_T& self, int32_t frames) noexcept
+      : self{self}
+      , frames{frames}
+      , start{instrumentation::now()}
+  {
+  }
+
+  ~instrumentation_scope()
+  {
+    const uint64_t end = instrumentation::now();
+    int32_t voices = 0;
+    if constexpr (requires { self.playing_voices(); })
+      voices = self.playing_voices();
+    self.processor.stats.block().add(start, end - start, frames, voices);
+  }
+
+  instrumentation_scope(const instrumentation_scope&) = delete;
+  instrumentation_scope& operator=(const instrumentation_scope&) = delete;
+
+private:
+  Effect_T& self;
+  int32_t frames{};
+  uint64_t start{};
+};
+#else
+template <typename Effect_T>
+struct instrumentation_scope
+{
+  instrumentation_scope(Effect_T&, int32_t) noexcept { }
+};
+#endif
+
+}
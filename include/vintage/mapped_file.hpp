@@ -0,0 +1,131 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <cinttypes>
+#include <cstddef>
+#include <utility>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vintage
+{
+
+// Read-only memory mapping of a whole file: pages are only loaded when they
+// are first accessed.
+struct mapped_file
+{
+  mapped_file() = default;
+  explicit mapped_file(const char* path) { open(path); }
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  mapped_file(mapped_file&& other) noexcept
+      : bytes{std::exchange(other.bytes, nullptr)}
+      , length{std::exchange(other.length, 0)}
+  {
+  }
+  mapped_file& operator=(mapped_file&& other) noexcept
+  {
+    close();
+    bytes = std::exchange(other.bytes, nullptr);
+    length = std::exchange(other.length, 0);
+    return *this;
+  }
+  ~mapped_file() { close(); }
+
+  bool open(const char* path) noexcept
+  {
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER file_size{};
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+      HANDLE mapping
+          = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping)
+      {
+        bytes = static_cast<const char*>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (bytes)
+          length = file_size.QuadPart;
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(file);
+#else
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    struct stat st
+    {
+    };
+    if (::fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+      {
+        bytes = static_cast<const char*>(p);
+        length = st.st_size;
+      }
+    }
+    ::close(fd);
+#endif
+    return bytes != nullptr;
+  }
+
+  void close() noexcept
+  {
+    if (!bytes)
+      return;
+#if defined(_WIN32)
+    UnmapViewOfFile(bytes);
+#else
+    ::munmap(const_cast<char*>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+  }
+
+  // Hints that the file will be read once from start to end, so that pages
+  // are read ahead and can be dropped after use
+  void sequential() const noexcept
+  {
+#if !defined(_WIN32)
+    if (bytes)
+      ::posix_madvise(
+          const_cast<char*>(bytes), length, POSIX_MADV_SEQUENTIAL);
+#endif
+  }
+
+  const char* data() const noexcept { return bytes; }
+  std::size_t size() const noexcept { return length; }
+  bool empty() const noexcept { return length == 0; }
+
+private:
+  const char* bytes{};
+  std::size_t length{};
+};
+
+}
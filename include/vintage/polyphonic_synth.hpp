@@ -2,8 +2,18 @@
 
 /* SPDX-License-Identifier: AGPL-3.0-or-later */
 
+#include <vintage/chunks.hpp>
+#include <vintage/dsp/fast_math.hpp>
+#include <vintage/event_buffer.hpp>
 #include <vintage/helpers.hpp>
+#include <vintage/render_pool.hpp>
+#include <vintage/silence.hpp>
+#include <vintage/tuning.hpp>
 #include <vintage/vintage.hpp>
+#include <vintage/voice_lanes.hpp>
+#include <vintage/voice_pool.hpp>
+
+#include <chrono>
 
 namespace vintage
 {
@@ -18,6 +28,20 @@ concept synth_voice = requires(T t)
   t.recycle;
 };
 
+template <typename T>
+concept synth_lanes = requires
+{
+  T::lanes;
+};
+
+// Which voice makes room for a new one once the polyphony is reached
+enum class voice_stealing
+{
+  oldest,
+  quietest,
+  released_first
+};
+
 template <typename T>
 struct PolyphonicSynthesizer : vintage::Effect
 {
@@ -31,6 +55,7 @@ struct PolyphonicSynthesizer : vintage::Effect
   SynthControls<T> controls;
   Processor<T> processor;
   Programs<T> programs;
+  Chunks<T> chunks;
 
   explicit PolyphonicSynthesizer(vintage::HostCallback master)
       : master{master}
@@ -67,7 +92,6 @@ struct PolyphonicSynthesizer : vintage::Effect
 
     processor.init(*this);
     controls.init(*this);
-    programs.init(*this);
 
     Effect::numInputs = T::channels;
     Effect::numOutputs = T::channels;
@@ -81,10 +105,36 @@ struct PolyphonicSynthesizer : vintage::Effect
     Effect::uniqueID = T::unique_id;
     Effect::version = 1;
 
-    controls.read(implementation);
+    controls.read(implementation.parameters);
+    controls.notify(implementation);
+    chunks.init(*this);
+    programs.init(*this);
+
+    // Stolen voices keep playing while they fade out: leave them room
+    voices.reserve(2 * polyphony);
 
-    voices.reserve(127);
-    release_voices.reserve(127);
+    if constexpr (requires { T::render_threads; })
+    {
+      // No more workers than the other cores of the machine. Without any,
+      // the jobs still run, in turn, so that the output is the same.
+      const int32_t threads = std::min<int32_t>(
+          T::render_threads, int32_t(std::thread::hardware_concurrency()) - 1);
+      if (threads > 0)
+        pool = std::make_unique<render_pool>(threads);
+      scratch_float
+          = std::make_unique<float[]>(max_jobs * T::channels * job_frames);
+      scratch_double
+          = std::make_unique<double[]>(max_jobs * T::channels * job_frames);
+    }
+
+    // Microtuning: the table stays in 12-TET if the files cannot be read
+    if constexpr (requires { T::scala_file; })
+    {
+      if constexpr (requires { T::keyboard_mapping_file; })
+        tuning.load_scala_files(T::scala_file, T::keyboard_mapping_file);
+      else
+        tuning.load_scala_files(T::scala_file);
+    }
   }
 
   intptr_t request(HostOpcodes opcode, int a, int b, void* c, float d)
@@ -92,50 +142,60 @@ struct PolyphonicSynthesizer : vintage::Effect
     return this->master(this, static_cast<int32_t>(opcode), a, b, c, d);
   }
 
+  // Called when the host suspends processing: all the notes are cut, and
+  // the events not yet applied are discarded.
+  void reset() noexcept
+  {
+    voices.clear();
+    midi_events.clear();
+    parameter_events.clear();
+    silence.reset();
+    stolen_voices = 0;
+    voice_limit = polyphony;
+    bend_ratio = 1.f;
+  }
+
   void note_on(int32_t note, int32_t velocity)
   {
-    voices.push_back(
-        {.note = float(note), .velocity = float(velocity), .detune = 0.0f});
+    // Keys left unmapped by the tuning stay silent
+    if (tuning.frequency[note] == 0.f)
+      return;
+
+    start_voice({.note = note, .velocity = float(velocity), .detune = 0.0f});
     float unison = this->controls.unison_voices * 20.0;
     float detune = this->controls.unison_detune;
     float vol = this->controls.unison_volume;
     for (float i = -unison; i <= unison; i += 2.f)
     {
-      voices.push_back(
-          {.note = float(note),
+      start_voice(
+          {.note = note,
            .velocity = velocity * vol,
            .detune = i * (1.f + detune),
-           .pan = (int(i/2) % 2) ? -1.f : 1.f });
+           .pan = (int(i / 2) % 2) ? -1.f : 1.f});
     }
   }
 
   void note_off(int32_t note, int32_t velocity)
   {
-    for (auto it = voices.begin(); it != voices.end();)
+    for (int32_t i = 0, n = voices.size(); i < n; i++)
     {
-      if (it->note == note)
+      auto& voice = voices[i];
+      if (voice.note == note && !voice.released)
       {
-        it->implementation.release_frame = it->implementation.elapsed;
-        release_voices.push_back(*it);
-        it = voices.erase(it);
-      }
-      else
-      {
-        ++it;
+        voice.implementation.release_frame = voice.implementation.elapsed;
+        voice.released = true;
       }
     }
   }
 
+  // Bends every voice at once: voices read the ratio when they update.
+  // The range is +/- 2 semitones unless T defines pitch_bend_range.
   void bend(int32_t bend)
   {
-    for (auto& voice : voices)
-    {
-      voice.bend = bend / 100.;
-    }
-    for (auto& voice : release_voices)
-    {
-      voice.bend = bend / 100.;
-    }
+    float range = 2.f;
+    if constexpr (requires { T::pitch_bend_range; })
+      range = T::pitch_bend_range;
+    bend_ratio = dsp::fast_semitones_to_ratio(range * bend / 8192.f);
   }
 
   void midi_input(const vintage::MidiEvent& e)
@@ -173,32 +233,410 @@ struct PolyphonicSynthesizer : vintage::Effect
 
   struct voice
   {
-    float note{};
+    int32_t note{};
     float velocity{};
     float detune{};
-    float bend{};
     float pan{};
 
-    typename T::voice implementation;
+    // Set upon note off: the voice keeps playing until it asks to be recycled
+    bool released{};
 
-    template <typename sample_t>
-    void
-    process(PolyphonicSynthesizer& self, sample_t** outputs, int32_t frames)
+    // Set when the voice is stolen: it is recycled once faded out
+    bool stolen{};
+    float fade{1.f};
+
+    typename T::voice implementation{};
+
+    // Computes the parameters of the voice for the upcoming block
+    void update(PolyphonicSynthesizer& self)
     {
       implementation.frequency
-          = 440. * std::pow(2.0, (note - 69) / 12.0) + detune + bend;
-      implementation.volume = velocity / 127.;
+          = (self.tuning.frequency[note] + detune) * self.bend_ratio;
+      implementation.volume = velocity / 127. * fade;
 
-      if constexpr(std::size(decltype(implementation.pan){}) == 2)
+      if constexpr (std::size(decltype(implementation.pan){}) == 2)
       {
         implementation.pan[0] = pan == -1.f ? 1. : 0.;
-        implementation.pan[1] = pan ==  1.f ? 1. : 0.;
+        implementation.pan[1] = pan == 1.f ? 1. : 0.;
       }
+    }
 
+    template <typename sample_t>
+    void
+    process(PolyphonicSynthesizer& self, sample_t** outputs, int32_t frames)
+    {
+      update(self);
       implementation.process(self.implementation, outputs, frames);
     }
   };
 
+  // Polyphony, set by declaring e.g.
+  //
+  //   static constexpr int32_t max_voices = 64;
+  //   static constexpr auto voice_stealing = vintage::voice_stealing::oldest;
+  //
+  // Once max_voices are playing, each new voice steals one of them, by
+  // default a released one if any, else the oldest. Stolen voices fade out
+  // in a few milliseconds instead of being cut.
+  static constexpr int32_t polyphony = []
+  {
+    if constexpr (requires { T::max_voices; })
+      return int32_t(T::max_voices);
+    else
+      return 1024;
+  }();
+
+  static constexpr vintage::voice_stealing stealing_policy = []
+  {
+    if constexpr (requires { T::voice_stealing; })
+      return vintage::voice_stealing(T::voice_stealing);
+    else
+      return vintage::voice_stealing::released_first;
+  }();
+
+  static constexpr float fade_time = 0.005f;
+  static constexpr int32_t fade_step = 16;
+
+  // Frames of output due once no voice plays
+  int64_t tail_length() const noexcept requires has_tail<T>
+  {
+    return implementation.tail_frames;
+  }
+
+  int32_t playing_voices() const noexcept
+  {
+    return voices.size() - stolen_voices;
+  }
+
+  void start_voice(voice&& v) noexcept
+  {
+    while (playing_voices() >= voice_limit)
+      if (!steal_voice())
+        break;
+
+    // Many notes in a short time: cut the stolen voice nearest to silence
+    if (voices.full() && stolen_voices > 0)
+    {
+      int32_t victim = -1;
+      for (int32_t i = 0, n = voices.size(); i < n; i++)
+        if (voices[i].stolen
+            && (victim < 0 || voices[i].fade < voices[victim].fade))
+          victim = i;
+      voices.recycle(victim);
+      stolen_voices--;
+    }
+
+    voices.acquire(std::move(v));
+  }
+
+  // Starts fading out a playing voice chosen by the stealing policy.
+  // Returns false if there is none.
+  bool steal_voice() noexcept
+  {
+    auto loudness = [](const voice& v)
+    {
+      if constexpr (requires { v.implementation.level(); })
+        return float(v.implementation.level());
+      else
+        return v.velocity;
+    };
+
+    // Returns true if a is a better victim than b
+    auto before = [loudness](const voice& a, const voice& b)
+    {
+      if constexpr (stealing_policy == vintage::voice_stealing::quietest)
+      {
+        if (loudness(a) != loudness(b))
+          return loudness(a) < loudness(b);
+      }
+      else if constexpr (
+          stealing_policy == vintage::voice_stealing::released_first)
+      {
+        if (a.released != b.released)
+          return a.released;
+      }
+      return a.implementation.elapsed > b.implementation.elapsed;
+    };
+
+    int32_t victim = -1;
+    for (int32_t i = 0, n = voices.size(); i < n; i++)
+    {
+      const auto& v = voices[i];
+      if (!v.stolen && (victim < 0 || before(v, voices[victim])))
+        victim = i;
+    }
+    if (victim < 0)
+      return false;
+
+    auto& v = voices[victim];
+    v.stolen = true;
+    v.released = true;
+    stolen_voices++;
+    return true;
+  }
+
+  int32_t fade_frames() const noexcept
+  {
+    float rate = 44100.f;
+    if constexpr (requires { implementation.sample_rate; })
+    {
+      if (implementation.sample_rate > 0)
+        rate = implementation.sample_rate;
+    }
+    return std::max(int32_t(rate * fade_time), fade_step);
+  }
+
+  // Optional bound on the processing time, as a fraction of the duration of
+  // the block, set by declaring e.g.
+  //
+  //   static constexpr float cpu_budget = 0.5f;
+  //
+  // When a block takes longer, the polyphony is lowered and the voices in
+  // excess are stolen; it then grows back one voice per block which stays
+  // well within the budget.
+  void enforce_budget(double seconds, int32_t frames) noexcept
+  {
+    if constexpr (requires { T::cpu_budget; })
+    {
+      if constexpr (requires { implementation.sample_rate; })
+      {
+        if (implementation.sample_rate <= 0)
+          return;
+
+        const double budget
+            = T::cpu_budget * frames / double(implementation.sample_rate);
+        if (seconds > budget)
+        {
+          const int32_t playing = playing_voices();
+          voice_limit = std::max(1, playing - std::max(1, playing / 8));
+          while (playing_voices() > voice_limit)
+            steal_voice();
+        }
+        else if (seconds < budget / 2 && voice_limit < polyphony)
+        {
+          voice_limit++;
+        }
+      }
+    }
+  }
+
+  // Renders the active voices in [begin; end) on top of outputs
+  template <typename sample_t>
+  void render_voices(
+      int32_t begin,
+      int32_t end,
+      sample_t** outputs,
+      int32_t frames)
+  {
+    if constexpr (synth_lanes<T>)
+    {
+      static constexpr int32_t width = T::lanes;
+      voice_lanes<T::channels, width> lanes;
+
+      for (int32_t batch = begin; batch < end; batch += width)
+      {
+        lanes.count = std::min(width, end - batch);
+
+        // Gather
+        for (int32_t l = 0; l < lanes.count; l++)
+        {
+          auto& v = voices[batch + l];
+          v.update(*this);
+
+          auto& impl = v.implementation;
+          lanes.frequency[l] = impl.frequency;
+          lanes.volume[l] = impl.volume;
+          if constexpr (requires { impl.phase; })
+            lanes.phase[l] = impl.phase;
+          for (int32_t c = 0; c < T::channels; c++)
+            lanes.pan[c][l] = impl.pan[c];
+          lanes.elapsed[l] = impl.elapsed;
+          lanes.release_frame[l] = impl.release_frame;
+          lanes.recycle[l] = impl.recycle;
+        }
+
+        // Padding lanes stay silent
+        for (int32_t l = lanes.count; l < width; l++)
+        {
+          lanes.frequency[l] = 0.f;
+          lanes.volume[l] = 0.f;
+          lanes.phase[l] = 0.f;
+          lanes.elapsed[l] = 0;
+          lanes.release_frame[l] = -1;
+          lanes.recycle[l] = false;
+        }
+
+        implementation.process_voices(lanes, outputs, frames);
+
+        // Scatter
+        for (int32_t l = 0; l < lanes.count; l++)
+        {
+          auto& impl = voices[batch + l].implementation;
+          if constexpr (requires { impl.phase; })
+            impl.phase = lanes.phase[l];
+          impl.elapsed = lanes.elapsed[l];
+          impl.recycle = lanes.recycle[l];
+        }
+      }
+    }
+    else
+    {
+      for (int32_t i = begin; i < end; i++)
+      {
+        voices[i].process(*this, outputs, frames);
+      }
+    }
+  }
+
+  // Frees the voices that were note'off'd and have finished fading out
+  void recycle_voices() noexcept
+  {
+    for (int32_t i = 0; i < voices.size();)
+    {
+      auto& voice = voices[i];
+      if (voice.released
+          && (voice.implementation.recycle || voice.fade <= 0.f))
+      {
+        stolen_voices -= voice.stolen;
+        voices.recycle(i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+
+  // Renders the frames [start; start + frames) of the output buffers.
+  // The ones that were note'off'd keep playing in order to cleanly fade out,
+  // until they signal that they can be recycled.
+  template <typename sample_t>
+  void render_sub_block(sample_t** outputs, int32_t start, int32_t frames)
+  {
+    sample_t* sub_outputs[T::channels];
+    for (int32_t c = 0; c < T::channels; c++)
+      sub_outputs[c] = outputs[c] + start;
+
+    // While voices are being stolen, render in short steps so that their
+    // volume ramps down smoothly
+    int32_t done = 0;
+    if (stolen_voices > 0)
+    {
+      const float step = float(fade_step) / fade_frames();
+      for (; done < frames && stolen_voices > 0; done += fade_step)
+      {
+        const int32_t n = std::min(fade_step, frames - done);
+        render_all(sub_outputs, n);
+        for (int32_t i = 0, count = voices.size(); i < count; i++)
+          if (auto& v = voices[i]; v.stolen)
+            v.fade = std::max(0.f, v.fade - step);
+        recycle_voices();
+
+        for (int32_t c = 0; c < T::channels; c++)
+          sub_outputs[c] += n;
+      }
+    }
+
+    if (done < frames)
+    {
+      render_all(sub_outputs, frames - done);
+      recycle_voices();
+    }
+  }
+
+  // Multithreaded rendering, enabled by declaring e.g.
+  //
+  //   static constexpr int32_t render_threads = 3;
+  //
+  // Voices are split in jobs spread across the render pool and the audio
+  // thread. Each job renders to its own scratch buffer and the buffers are
+  // summed in job order, so that the output does not depend on which thread
+  // ran which job, nor on whether there is a pool at all. Voice processing
+  // must then not modify the implementation.
+  static constexpr int32_t max_jobs = 64;
+  static constexpr int32_t job_frames = 256;
+  static constexpr int32_t job_voices = [] {
+    if constexpr (synth_lanes<T>)
+      return T::lanes;
+    else
+      return 4;
+  }();
+
+  // Below this, waking up the workers costs more than it saves
+  static constexpr int32_t min_parallel_voices = 2 * job_voices;
+  static constexpr int32_t min_parallel_frames = 32;
+
+  template <typename sample_t>
+  void render_all(sample_t** outputs, int32_t frames)
+  {
+    const int32_t count = voices.size();
+    if (!scratch_float || count < min_parallel_voices
+        || frames < min_parallel_frames)
+    {
+      render_voices(0, count, outputs, frames);
+      return;
+    }
+
+    const int32_t per_job
+        = std::max(job_voices, (count + max_jobs - 1) / max_jobs);
+    const int32_t jobs = (count + per_job - 1) / per_job;
+
+    sample_t* scratch;
+    if constexpr (std::is_same_v<sample_t, float>)
+      scratch = scratch_float.get();
+    else
+      scratch = scratch_double.get();
+
+    for (int32_t offset = 0; offset < frames; offset += job_frames)
+    {
+      const int32_t n = std::min(job_frames, frames - offset);
+      auto job = [this, scratch, per_job, count, n](int32_t j)
+      {
+        // The floating-point environment is per thread
+        [[maybe_unused]] denormal_scope_for<T> denormals;
+        sample_t* out[T::channels];
+        for (int32_t c = 0; c < T::channels; c++)
+        {
+          out[c] = scratch + (j * T::channels + c) * job_frames;
+          std::fill_n(out[c], n, sample_t(0));
+        }
+        render_voices(
+            j * per_job, std::min(count, (j + 1) * per_job), out, n);
+      };
+      if (pool)
+        pool->run(jobs, job);
+      else
+        for (int32_t j = 0; j < jobs; j++)
+          job(j);
+
+      for (int32_t j = 0; j < jobs; j++)
+        for (int32_t c = 0; c < T::channels; c++)
+        {
+          const sample_t* in = scratch + (j * T::channels + c) * job_frames;
+          sample_t* out = outputs[c] + offset;
+          for (int32_t i = 0; i < n; i++)
+            out[i] += in[i];
+        }
+    }
+  }
+
+  // Silence, but the events are still applied so that no note hangs once
+  // the bypass is lifted
+  template <typename sample_t>
+  void bypass(sample_t** outputs, int32_t frames)
+  {
+    controls.write(implementation);
+    chunks.write(implementation);
+    for (const auto& event : parameter_events)
+      controls.apply(implementation, event);
+    for (const auto& event : midi_events)
+      midi_input(event);
+    parameter_events.clear();
+    midi_events.clear();
+
+    silence_detector::clear(outputs, T::channels, frames);
+  }
+
   void process(
       std::floating_point auto** inputs,
       std::floating_point auto** outputs,
@@ -208,43 +646,103 @@ struct PolyphonicSynthesizer : vintage::Effect
     if constexpr (requires { implementation.bypass; })
     {
       if (implementation.bypass)
+      {
+        bypass(outputs, frames);
         return;
+      }
     }
 
+    // Only synths with a CPU budget read the clock
+    [[maybe_unused]] std::chrono::steady_clock::time_point block_start;
+    if constexpr (requires { T::cpu_budget; })
+      block_start = std::chrono::steady_clock::now();
+
     // Before processing starts, we copy all our atomics back into the struct
     controls.write(implementation);
+    chunks.write(implementation);
 
-    // Clear buffer
-    for (int32_t c = 0; c < implementation.channels; c++)
-      for (int32_t i = 0; i < frames; i++)
-        outputs[c][i] = 0.0;
+    silence_detector::clear(outputs, T::channels, frames);
 
-    // Process voices
-    for (auto& voice : voices)
+    // No voice to render: only the parameters change
+    const bool idle = voices.empty() && midi_events.empty();
+    if (idle)
     {
-      voice.process(*this, outputs, frames);
+      for (const auto& event : parameter_events)
+        controls.apply(implementation, event);
+      parameter_events.clear();
     }
 
-    // Process voices that were note'off'd in order to cleanly fade out
-    for (auto it = release_voices.begin(); it != release_voices.end();)
+    // Process voices, splitting the block at each MIDI event and automation
+    // point so that notes start and stop, and parameters change, at the
+    // exact frame requested by the host. On the same frame, parameters
+    // change before notes start.
+    int32_t start = 0;
+    auto midi = midi_events.begin();
+    auto param = parameter_events.begin();
+    while (midi != midi_events.end() || param != parameter_events.end())
     {
-      auto& voice = *it;
-      voice.process(*this, outputs, frames);
-      if (voice.implementation.recycle)
-        it = release_voices.erase(it);
+      const bool is_param
+          = param != parameter_events.end()
+            && (midi == midi_events.end()
+                || param->deltaFrames <= midi->deltaFrames);
+      const int32_t offset = is_param ? param->deltaFrames : midi->deltaFrames;
+
+      const int32_t frame = std::clamp(offset, start, frames);
+      if (frame > start)
+      {
+        render_sub_block(outputs, start, frame - start);
+        start = frame;
+      }
+
+      if (is_param)
+      {
+        controls.apply(implementation, *param);
+        ++param;
+      }
       else
-        ++it;
+      {
+        midi_input(*midi);
+        ++midi;
+      }
     }
+    midi_events.clear();
+    parameter_events.clear();
+
+    if (!idle && start < frames)
+      render_sub_block(outputs, start, frames - start);
 
-    // Post-processing
+    if constexpr (requires { T::cpu_budget; })
+      enforce_budget(
+          std::chrono::duration<double>(
+              std::chrono::steady_clock::now() - block_start)
+              .count(),
+          frames);
+
+    // Post-processing, skipped once its tail has ended if T declares one
     if constexpr (effect_processor<float, T> || effect_processor<double, T>)
     {
+      if constexpr (has_tail<T>)
+      {
+        if (silence.update(idle, frames, tail_length()))
+          return;
+      }
       implementation.process(inputs, outputs, frames);
     }
   }
 
-  std::vector<voice> voices;
-  std::vector<voice> release_voices;
+  vintage::tuning tuning;
+  float bend_ratio = 1.f;
+
+  voice_pool<voice> voices;
+  int32_t stolen_voices{};
+  int32_t voice_limit{polyphony};
+  std::unique_ptr<render_pool> pool;
+  std::unique_ptr<float[]> scratch_float;
+  std::unique_ptr<double[]> scratch_double;
+
+  event_buffer<vintage::MidiEvent, 512> midi_events;
+  event_buffer<vintage::ParameterEvent, 512> parameter_events;
+  silence_detector silence;
 };
 }
 
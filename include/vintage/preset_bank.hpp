@@ -0,0 +1,175 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/mapped_file.hpp>
+#include <vintage/vintage.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstddef>
+#include <string_view>
+
+namespace vintage
+{
+
+// A bank of presets in the .fxb format, mapped in memory.
+//
+// Opening a bank only validates its header: in a regular bank, programs
+// all have the same size, so a program's offset is computed from its index,
+// and its name and values are read from the mapping when they are asked
+// for. Instantiating a plug-in with thousands of presets thus costs the same
+// as with one.
+//
+// Banks saved as an opaque chunk (FBCh) hold the state of the plug-in as
+// written by GetChunk, see chunks.hpp.
+//
+// All the fields of the format are big-endian.
+struct preset_bank
+{
+  static constexpr std::size_t bank_header_size = offsetof(Bank, content);
+  static constexpr std::size_t program_header_size
+      = offsetof(Program, content);
+  static_assert(bank_header_size == 156 && program_header_size == 56);
+
+  // Returns false if the file cannot be read, or is not a bank for the
+  // given plug-in
+  bool open(const char* path, int32_t unique_id) noexcept
+  {
+    close();
+    if (!file.open(path) || file.size() < bank_header_size + 4)
+      return close();
+
+    if (bank_field(offsetof(Bank, chunkMagic)) != Constants::ChunkMagic)
+      return close();
+    if (bank_field(offsetof(Bank, fxID)) != unique_id)
+      return close();
+
+    const int32_t magic = bank_field(offsetof(Bank, fxMagic));
+    const int32_t count = bank_field(offsetof(Bank, numPrograms));
+    if (magic == Constants::BankMagic)
+    {
+      if (count <= 0 || file.size() < bank_header_size + program_header_size)
+        return close();
+
+      const int32_t params
+          = program_field(0, offsetof(Program, numParams));
+      if (params < 0)
+        return close();
+
+      stride = program_header_size + 4 * std::size_t(params);
+      if ((file.size() - bank_header_size) / stride < std::size_t(count))
+        return close();
+
+      programs = count;
+    }
+    else if (magic == Constants::ChunkBankMagic)
+    {
+      // The chunk follows its size
+      const int32_t size = read_be(file.data() + bank_header_size);
+      if (size < 0 || file.size() - bank_header_size - 4 < std::size_t(size))
+        return close();
+
+      chunk_data = file.data() + bank_header_size + 4;
+      chunk_length = size;
+    }
+    else
+    {
+      return close();
+    }
+
+    current_program = std::clamp(
+        bank_field(offsetof(Bank, currentProgram)),
+        0,
+        std::max(programs - 1, 0));
+    return true;
+  }
+
+  bool close() noexcept
+  {
+    file.close();
+    programs = 0;
+    stride = 0;
+    chunk_data = nullptr;
+    chunk_length = 0;
+    current_program = 0;
+    return false;
+  }
+
+  // Number of programs, 0 for chunk banks
+  int32_t size() const noexcept { return programs; }
+
+  // Program selected when the bank was saved
+  int32_t current() const noexcept { return current_program; }
+
+  std::string_view name(int32_t index) const noexcept
+  {
+    if (index < 0 || index >= programs)
+      return {};
+
+    const char* str = program(index) + offsetof(Program, prgName);
+    const char* end = std::find(str, str + sizeof(Program::prgName), '\0');
+    return {str, std::size_t(end - str)};
+  }
+
+  // Copies up to count parameter values of a program. Parameters missing
+  // from the program are left unchanged. Returns false if the program is
+  // corrupted.
+  bool read(int32_t index, float* values, int32_t count) const noexcept
+  {
+    if (index < 0 || index >= programs)
+      return false;
+    if (program_field(index, offsetof(Program, chunkMagic))
+            != Constants::ChunkMagic
+        || program_field(index, offsetof(Program, fxMagic))
+               != Constants::EffectMagic)
+      return false;
+
+    const int32_t params = program_field(index, offsetof(Program, numParams));
+    if (params < 0 || program_header_size + 4 * std::size_t(params) > stride)
+      return false;
+
+    const char* p = program(index) + program_header_size;
+    for (int32_t i = 0, n = std::min(params, count); i < n; i++)
+      values[i] = std::bit_cast<float>(read_be(p + 4 * i));
+    return true;
+  }
+
+  // Contents of a chunk bank
+  const char* chunk() const noexcept { return chunk_data; }
+  std::size_t chunk_size() const noexcept { return chunk_length; }
+
+private:
+  static int32_t read_be(const char* p) noexcept
+  {
+    const auto* b = reinterpret_cast<const uint8_t*>(p);
+    return int32_t(
+        (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16)
+        | (uint32_t(b[2]) << 8) | uint32_t(b[3]));
+  }
+
+  const char* program(int32_t index) const noexcept
+  {
+    return file.data() + bank_header_size + stride * index;
+  }
+
+  int32_t bank_field(std::size_t offset) const noexcept
+  {
+    return read_be(file.data() + offset);
+  }
+
+  int32_t program_field(int32_t index, std::size_t offset) const noexcept
+  {
+    return read_be(program(index) + offset);
+  }
+
+  mapped_file file;
+  int32_t programs{};
+  int32_t current_program{};
+  std::size_t stride{};
+  const char* chunk_data{};
+  std::size_t chunk_length{};
+};
+
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace vintage
+{
+
+// Worker threads which share the jobs of a block with the audio thread.
+//
+// Jobs are split evenly across the participants; each one runs its own
+// share from the front, then steals from the back of the others' shares.
+// A share is a [begin; end) range packed in a single atomic, so handing out
+// a job is one compare-and-swap and nothing ever locks.
+//
+// Workers spin for a short while after a block, then sleep until the next
+// one; so does the calling thread while the last jobs finish on workers.
+// Workers get a real-time priority when the system allows it, but are not
+// pinned: with several instances, each with its own pool, fixed cores
+// would pile the workers of all of them onto the same few cores.
+struct render_pool
+{
+  explicit render_pool(int32_t threads)
+      : participants{threads + 1}
+      , shares{std::make_unique<share[]>(threads + 1)}
+  {
+    workers.reserve(threads);
+    for (int32_t i = 1; i <= threads; i++)
+    {
+      workers.emplace_back([this, i] { worker(i); });
+      configure(workers.back());
+    }
+  }
+
+  render_pool(const render_pool&) = delete;
+  render_pool& operator=(const render_pool&) = delete;
+
+  ~render_pool()
+  {
+    stop.store(true, std::memory_order_relaxed);
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_all();
+    for (auto& w : workers)
+      w.join();
+  }
+
+  int32_t threads() const noexcept { return participants - 1; }
+
+  // Calls job(j) for every j in [0; count), from the calling thread and the
+  // workers. Returns once all the jobs are done.
+  template <typename F>
+  void run(int32_t count, F&& job)
+  {
+    function = [](void* context, int32_t j)
+    { (*static_cast<std::remove_reference_t<F>*>(context))(j); };
+    context = &job;
+    pending.store(count, std::memory_order_relaxed);
+
+    for (int32_t i = 0; i < participants; i++)
+    {
+      const uint32_t begin = int64_t(count) * i / participants;
+      const uint32_t end = int64_t(count) * (i + 1) / participants;
+      shares[i].range.store(pack(begin, end), std::memory_order_release);
+    }
+
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_all();
+
+    work(0);
+
+    // The last jobs may still be running on workers, which may have been
+    // preempted: spin a little, then sleep until they are done
+    for (int32_t i = 0; i < spin_count; i++)
+    {
+      if (pending.load(std::memory_order_acquire) == 0)
+        return;
+      pause();
+    }
+    sleeping.store(true);
+    for (int32_t p; (p = pending.load()) != 0;)
+      pending.wait(p);
+    sleeping.store(false, std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr int32_t spin_count = 4096;
+
+  struct alignas(64) share
+  {
+    std::atomic<uint64_t> range{};
+  };
+
+  static uint64_t pack(uint32_t begin, uint32_t end) noexcept
+  {
+    return uint64_t(end) << 32 | begin;
+  }
+
+  static void pause() noexcept
+  {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  // Takes a job from the front of the share of its owner
+  static bool pop(share& s, int32_t& job) noexcept
+  {
+    uint64_t r = s.range.load(std::memory_order_acquire);
+    for (;;)
+    {
+      const uint32_t begin = r, end = r >> 32;
+      if (begin >= end)
+        return false;
+      if (s.range.compare_exchange_weak(
+              r, pack(begin + 1, end), std::memory_order_acquire))
+      {
+        job = begin;
+        return true;
+      }
+    }
+  }
+
+  // Takes a job from the back of the share of another participant
+  static bool steal(share& s, int32_t& job) noexcept
+  {
+    uint64_t r = s.range.load(std::memory_order_acquire);
+    for (;;)
+    {
+      const uint32_t begin = r, end = r >> 32;
+      if (begin >= end)
+        return false;
+      if (s.range.compare_exchange_weak(
+              r, pack(begin, end - 1), std::memory_order_acquire))
+      {
+        job = end - 1;
+        return true;
+      }
+    }
+  }
+
+  void execute(int32_t job) noexcept
+  {
+    function(context, job);
+
+    // Sequentially consistent, as in run(): either run() sees no job left
+    // or the last job sees it sleeping
+    if (pending.fetch_sub(1) == 1 && sleeping.load())
+      pending.notify_one();
+  }
+
+  void work(int32_t self) noexcept
+  {
+    int32_t job;
+    while (pop(shares[self], job))
+      execute(job);
+
+    for (int32_t k = 1; k < participants; k++)
+    {
+      auto& victim = shares[(self + k) % participants];
+      while (steal(victim, job))
+        execute(job);
+    }
+  }
+
+  void worker(int32_t self) noexcept
+  {
+    uint32_t seen = epoch.load(std::memory_order_acquire);
+    for (;;)
+    {
+      // Blocks usually follow each other closely: spin a little before
+      // going to sleep, to be ready for the next one
+      for (int32_t i = 0; i < spin_count; i++)
+      {
+        if (epoch.load(std::memory_order_acquire) != seen)
+          break;
+        pause();
+      }
+      epoch.wait(seen, std::memory_order_acquire);
+      seen = epoch.load(std::memory_order_acquire);
+
+      if (stop.load(std::memory_order_relaxed))
+        return;
+      work(self);
+    }
+  }
+
+  // Best effort: fails silently without the required privileges
+  static void configure(std::thread& t) noexcept
+  {
+#if defined(__linux__)
+    sched_param param{};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(t.native_handle(), SCHED_FIFO, &param);
+#elif defined(_WIN32)
+    SetThreadPriority(t.native_handle(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+    (void)t;
+#endif
+  }
+
+  const int32_t participants;
+  std::unique_ptr<share[]> shares;
+  std::vector<std::thread> workers;
+
+  void (*function)(void*, int32_t){};
+  void* context{};
+
+  alignas(64) std::atomic<int32_t> pending{};
+  std::atomic<bool> sleeping{};
+  alignas(64) std::atomic<uint32_t> epoch{};
+  std::atomic<bool> stop{};
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+
+namespace vintage
+{
+
+template <typename T>
+concept has_tail = requires(T t)
+{
+  t.tail_frames;
+};
+
+// Lets idle instances skip processing.
+//
+// Implementations opt in by declaring how long their output may last after
+// their input becomes silent, e.g. for a memoryless effect:
+//
+//   static constexpr int32_t tail_frames = 0;
+//
+// The wrapper adds the latency of the plug-in, if any, and answers this to
+// GetTailSize; once the input has been silent for that long, it zero-fills
+// the outputs instead of processing.
+// tail_frames can also be a regular member if it depends on the settings.
+struct silence_detector
+{
+  // About -140 dB
+  static constexpr float threshold = 1e-7f;
+
+  template <typename sample_t>
+  static bool is_silent(
+      sample_t* const* buffers,
+      int32_t channels,
+      int32_t frames) noexcept
+  {
+    // Counting instead of exiting early or taking the maximum, so that the
+    // loop vectorizes without relaxing the floating-point semantics
+    int32_t loud = 0;
+    for (int32_t c = 0; c < channels; c++)
+    {
+      const sample_t* in = buffers[c];
+      for (int32_t i = 0; i < frames; i++)
+        loud += std::abs(in[i]) > sample_t(threshold);
+    }
+    return loud == 0;
+  }
+
+  template <typename sample_t>
+  static void clear(
+      sample_t* const* buffers,
+      int32_t channels,
+      int32_t frames) noexcept
+  {
+    for (int32_t c = 0; c < channels; c++)
+      std::fill_n(buffers[c], frames, sample_t(0));
+  }
+
+  // Counts the silent frames; returns true when the block can be skipped,
+  // i.e. it is silent and so was everything since the tail ended
+  bool update(bool silent, int32_t frames, int64_t tail) noexcept
+  {
+    if (!silent)
+    {
+      silent_frames = 0;
+      return false;
+    }
+    const bool idle = silent_frames >= tail;
+    silent_frames += frames;
+    return idle;
+  }
+
+  void reset() noexcept { silent_frames = 0; }
+
+  int64_t silent_frames{};
+};
+
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <cinttypes>
+#include <concepts>
+
+#if __has_include(<experimental/simd>) && !defined(VINTAGE_NO_SIMD)
+#include <experimental/simd>
+#define VINTAGE_HAS_SIMD 1
+#else
+#define VINTAGE_HAS_SIMD 0
+#endif
+
+namespace vintage
+{
+#if VINTAGE_HAS_SIMD
+// Widest pack of samples supported by the target architecture
+template <typename T>
+using simd = std::experimental::native_simd<T>;
+
+template <typename T>
+concept simd_pack = std::experimental::is_simd_v<T>;
+#else
+template <typename T>
+concept simd_pack = false;
+#endif
+
+// Either a single sample or a pack of samples.
+// Per-sample processors which accept this instead of std::floating_point get
+// called on whole packs by the framework, e.g.:
+//
+//   auto process(vintage::sample auto input) { return gain * input; }
+template <typename T>
+concept sample = std::floating_point<T> || simd_pack<T>;
+
+#if VINTAGE_HAS_SIMD
+template <typename T, typename sample_t>
+concept simd_sample_processor = requires(T& t, vintage::simd<sample_t> x)
+{
+  t.process(x);
+};
+#else
+template <typename T, typename sample_t>
+concept simd_sample_processor = false;
+#endif
+
+// Drives a per-sample processor over a block, one sample at a time
+template <typename T, typename sample_t>
+void process_samples_scalar(
+    T& implementation,
+    sample_t** inputs,
+    sample_t** outputs,
+    int32_t channels,
+    int32_t frames)
+{
+  for (int32_t c = 0; c < channels; ++c)
+  {
+    for (int32_t i = 0; i < frames; i++)
+    {
+      outputs[c][i] = implementation.process(inputs[c][i]);
+    }
+  }
+}
+
+// Drives a per-sample processor over a block, using SIMD packs when the
+// processor supports them and a scalar loop for the remaining frames.
+template <typename T, typename sample_t>
+void process_samples(
+    T& implementation,
+    sample_t** inputs,
+    sample_t** outputs,
+    int32_t channels,
+    int32_t frames)
+{
+#if VINTAGE_HAS_SIMD
+  if constexpr (simd_sample_processor<T, sample_t>)
+  {
+    using pack = vintage::simd<sample_t>;
+    static constexpr auto aligned = std::experimental::element_aligned;
+    static constexpr int32_t width = pack::size();
+    static constexpr int32_t unroll = 4;
+    const int32_t unrolled_frames = frames - frames % (unroll * width);
+    const int32_t vector_frames = frames - frames % width;
+
+    for (int32_t c = 0; c < channels; ++c)
+    {
+      const sample_t* in = inputs[c];
+      sample_t* out = outputs[c];
+
+      // All the loads happen before the stores: as the output may alias the
+      // processor's state, this lets the compiler reuse the parameters
+      // it loaded across several packs.
+      for (int32_t i = 0; i < unrolled_frames; i += unroll * width)
+      {
+        pack x[unroll];
+        for (int32_t u = 0; u < unroll; u++)
+          x[u].copy_from(in + i + u * width, aligned);
+        for (int32_t u = 0; u < unroll; u++)
+          x[u] = implementation.process(x[u]);
+        for (int32_t u = 0; u < unroll; u++)
+          x[u].copy_to(out + i + u * width, aligned);
+      }
+      for (int32_t i = unrolled_frames; i < vector_frames; i += width)
+      {
+        pack x(in + i, aligned);
+        x = implementation.process(x);
+        x.copy_to(out + i, aligned);
+      }
+      for (int32_t i = vector_frames; i < frames; i++)
+      {
+        out[i] = implementation.process(in[i]);
+      }
+    }
+    return;
+  }
+#endif
+  process_samples_scalar(implementation, inputs, outputs, channels, frames);
+}
+}
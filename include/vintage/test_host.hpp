@@ -0,0 +1,479 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/vintage.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace vintage
+{
+
+using plugin_entry = Effect* (*)(HostCallback);
+
+// A plug-in binary, loaded at run-time
+struct plugin_library
+{
+  plugin_library() = default;
+  explicit plugin_library(const char* path) { open(path); }
+  plugin_library(const plugin_library&) = delete;
+  plugin_library& operator=(const plugin_library&) = delete;
+  plugin_library(plugin_library&& other) noexcept
+      : handle{std::exchange(other.handle, nullptr)}
+  {
+  }
+  plugin_library& operator=(plugin_library&& other) noexcept
+  {
+    close();
+    handle = std::exchange(other.handle, nullptr);
+    return *this;
+  }
+  ~plugin_library() { close(); }
+
+  bool open(const char* path) noexcept
+  {
+    close();
+#if defined(_WIN32)
+    handle = LoadLibraryA(path);
+#else
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+    return handle != nullptr;
+  }
+
+  void close() noexcept
+  {
+    if (!handle)
+      return;
+#if defined(_WIN32)
+    FreeLibrary(static_cast<HMODULE>(handle));
+#else
+    dlclose(handle);
+#endif
+    handle = nullptr;
+  }
+
+  // The VSTPluginMain symbol, or nullptr
+  plugin_entry entry() const noexcept
+  {
+    if (!handle)
+      return nullptr;
+#if defined(_WIN32)
+    return reinterpret_cast<plugin_entry>(
+        GetProcAddress(static_cast<HMODULE>(handle), "VSTPluginMain"));
+#else
+    return reinterpret_cast<plugin_entry>(dlsym(handle, "VSTPluginMain"));
+#endif
+  }
+
+  explicit operator bool() const noexcept { return handle != nullptr; }
+
+  void* handle{};
+};
+
+// Stand-in for a host, to run plug-ins headlessly: in benchmarks, profilers
+// or regression tests.
+//
+// It answers the host requests of the plug-ins with fixed settings, drives
+// the lifecycle opcodes, and renders in blocks of block_size frames. MIDI and
+// automation are scheduled at absolute frames beforehand; they are sent
+// through ProcessEvents before the block they fall in, at their offset.
+// Inputs are played from the signals given to input(); the outputs are
+// appended to captured() unless capture is false.
+//
+// Everything runs on the calling thread. The entry point is either linked
+// directly or taken from a plugin_library.
+struct test_host
+{
+  explicit test_host(
+      plugin_entry entry,
+      double sample_rate = 44100.,
+      int32_t block_size = 512)
+      : sample_rate{sample_rate}
+      , block_size{block_size}
+  {
+    // The plug-in may call back before it returns its Effect
+    constructing = this;
+    effect = entry ? entry(callback) : nullptr;
+    constructing = nullptr;
+    if (!effect)
+      return;
+
+    effect->user = this;
+    inputs.resize(effect->numInputs);
+    captured_outputs.resize(effect->numOutputs);
+    dispatch(EffectOpcodes::Open);
+  }
+
+  test_host(const test_host&) = delete;
+  test_host& operator=(const test_host&) = delete;
+
+  ~test_host()
+  {
+    if (!effect)
+      return;
+    stop();
+    dispatch(EffectOpcodes::Close);
+  }
+
+  explicit operator bool() const noexcept { return effect != nullptr; }
+
+  intptr_t dispatch(
+      EffectOpcodes opcode,
+      int32_t index = 0,
+      intptr_t value = 0,
+      void* ptr = nullptr,
+      float opt = 0.f)
+  {
+    return effect->dispatcher(
+        effect, static_cast<int32_t>(opcode), index, value, ptr, opt);
+  }
+
+  // Sends the settings and resumes processing
+  void start()
+  {
+    if (running)
+      return;
+    dispatch(EffectOpcodes::SetSampleRate, 0, 0, nullptr, float(sample_rate));
+    dispatch(EffectOpcodes::SetBlockSize, 0, block_size);
+    dispatch(
+        EffectOpcodes::SetProcessPrecision,
+        0,
+        static_cast<intptr_t>(precision));
+    dispatch(EffectOpcodes::MainsChanged, 0, 1);
+    dispatch(EffectOpcodes::StartProcess);
+    running = true;
+  }
+
+  void stop()
+  {
+    if (!running)
+      return;
+    dispatch(EffectOpcodes::StopProcess);
+    dispatch(EffectOpcodes::MainsChanged, 0, 0);
+    running = false;
+  }
+
+  void note_on(int64_t frame, int32_t note, int32_t velocity, int32_t ch = 0)
+  {
+    midi(frame, 0x90 | (ch & 0xF), note, velocity);
+  }
+
+  void note_off(int64_t frame, int32_t note, int32_t ch = 0)
+  {
+    midi(frame, 0x80 | (ch & 0xF), note, 0);
+  }
+
+  void midi(int64_t frame, int32_t status, int32_t data1, int32_t data2)
+  {
+    MidiEvent ev;
+    ev.midiData[0] = char(status);
+    ev.midiData[1] = char(data1);
+    ev.midiData[2] = char(data2);
+    schedule(frame, &ev, sizeof(ev));
+  }
+
+  // Sample-accurate automation, with the event layout of vintage plug-ins
+  void automate(int64_t frame, int32_t index, float value)
+  {
+    ParameterEvent ev;
+    ev.index = index;
+    ev.value = value;
+    schedule(frame, &ev, sizeof(ev));
+  }
+
+  // Signal played into an input from the current position; silence follows
+  void input(int32_t channel, std::vector<double> signal)
+  {
+    inputs[channel].signal = std::move(signal);
+    inputs[channel].start = position;
+  }
+
+  // Renders frames in blocks, with the current precision. Plug-ins without
+  // double-precision processing are rendered in single precision.
+  void render(int64_t frames)
+  {
+    start();
+    if (precision == ProcessPrecision::Double
+        && effect->processDoubleReplacing)
+      render_blocks<double>(frames);
+    else
+      render_blocks<float>(frames);
+  }
+
+  // Processes a block of buffers owned by the caller, e.g. to stream a file
+  // through the plug-in. The scheduled events falling in the block are sent
+  // first. frames must not exceed block_size.
+  template <typename sample_t>
+  void process(sample_t** ins, sample_t** outs, int32_t frames)
+  {
+    start();
+    update_time();
+    send_events(frames);
+
+    if constexpr (std::is_same_v<sample_t, double>)
+      effect->processDoubleReplacing(effect, ins, outs, frames);
+    else
+      effect->processReplacing(effect, ins, outs, frames);
+
+    position += frames;
+  }
+
+  // Suspends the plug-in and starts over from frame 0, e.g. to render
+  // another file with the same instance
+  void rewind()
+  {
+    stop();
+    events.clear();
+    for (auto& in : inputs)
+      in = {};
+    clear_captured();
+    automation.clear();
+    position = 0;
+  }
+
+  const std::vector<double>& captured(int32_t channel) const noexcept
+  {
+    return captured_outputs[channel];
+  }
+
+  void clear_captured() noexcept
+  {
+    for (auto& out : captured_outputs)
+      out.clear();
+  }
+
+  Effect* effect{};
+
+  // Changes apply upon the next start()
+  double sample_rate{};
+  int32_t block_size{};
+  ProcessPrecision precision{ProcessPrecision::Single};
+
+  bool capture{true};
+  double tempo{120.};
+
+  // Frames rendered since the construction or the last rewind()
+  int64_t position{};
+
+  // Requests from the plug-in
+  struct automation_point
+  {
+    int64_t frame{};
+    int32_t index{};
+    float value{};
+  };
+  std::vector<automation_point> automation;
+  int32_t display_updates{};
+
+private:
+  struct scheduled_event
+  {
+    int64_t frame{};
+    Event event{};
+  };
+
+  struct input_signal
+  {
+    std::vector<double> signal;
+    int64_t start{};
+  };
+
+  // Same header as Events, with room for a whole block
+  static constexpr int32_t max_events = 512;
+  struct event_list
+  {
+    int32_t numEvents{};
+    intptr_t reserved{};
+    Event* events[max_events]{};
+  };
+
+  void schedule(int64_t frame, const void* ev, std::size_t bytes)
+  {
+    static_assert(sizeof(MidiEvent) == sizeof(Event));
+    static_assert(sizeof(ParameterEvent) == sizeof(Event));
+
+    scheduled_event s{.frame = std::max(frame, position)};
+    std::memcpy(&s.event, ev, bytes);
+
+    // Keeps the events sorted, in the order they were scheduled for a frame
+    auto it = std::upper_bound(
+        events.begin(),
+        events.end(),
+        s.frame,
+        [](int64_t f, const scheduled_event& e) { return f < e.frame; });
+    events.insert(it, s);
+  }
+
+  void send_events(int32_t frames)
+  {
+    const int64_t end = position + frames;
+    std::size_t count = 0;
+    while (count < events.size() && events[count].frame < end)
+      count++;
+
+    for (std::size_t first = 0; first < count; first += max_events)
+    {
+      event_list list;
+      const std::size_t n
+          = std::min<std::size_t>(count - first, max_events);
+      for (std::size_t i = 0; i < n; i++)
+      {
+        Event& ev = events[first + i].event;
+        ev.deltaFrames = int32_t(events[first + i].frame - position);
+        list.events[i] = &ev;
+      }
+      list.numEvents = int32_t(n);
+      dispatch(EffectOpcodes::ProcessEvents, 0, 0, &list);
+    }
+    events.erase(events.begin(), events.begin() + count);
+  }
+
+  template <typename sample_t>
+  void render_blocks(int64_t frames)
+  {
+    const int32_t ins = effect->numInputs;
+    const int32_t outs = effect->numOutputs;
+    std::vector<sample_t> buffers((ins + outs) * std::size_t(block_size));
+    std::vector<sample_t*> in_ptrs(ins), out_ptrs(outs);
+    for (int32_t c = 0; c < ins; c++)
+      in_ptrs[c] = buffers.data() + c * block_size;
+    for (int32_t c = 0; c < outs; c++)
+      out_ptrs[c] = buffers.data() + (ins + c) * block_size;
+
+    while (frames > 0)
+    {
+      const int32_t n = int32_t(std::min<int64_t>(frames, block_size));
+
+      for (int32_t c = 0; c < ins; c++)
+        read_input(c, in_ptrs[c], n);
+      for (int32_t c = 0; c < outs; c++)
+        std::fill_n(out_ptrs[c], n, sample_t(0));
+
+      process(in_ptrs.data(), out_ptrs.data(), n);
+
+      if (capture)
+        for (int32_t c = 0; c < outs; c++)
+          captured_outputs[c].insert(
+              captured_outputs[c].end(), out_ptrs[c], out_ptrs[c] + n);
+
+      frames -= n;
+    }
+  }
+
+  template <typename sample_t>
+  void read_input(int32_t channel, sample_t* out, int32_t frames) const
+  {
+    const auto& in = inputs[channel];
+    const int64_t size = int64_t(in.signal.size());
+    for (int32_t i = 0; i < frames; i++)
+    {
+      const int64_t k = position - in.start + i;
+      out[i] = k < size ? sample_t(in.signal[k]) : sample_t(0);
+    }
+  }
+
+  void update_time() noexcept
+  {
+    time.samplePos = double(position);
+    time.sampleRate = sample_rate;
+    time.nanoSeconds = double(position) / sample_rate * 1e9;
+    time.tempo = tempo;
+    time.ppqPos = double(position) / sample_rate * tempo / 60.;
+    time.timeSigNumerator = 4;
+    time.timeSigDenominator = 4;
+    time.flags = TimeInfoFlags::TransportPlaying | TimeInfoFlags::NanosValid
+                 | TimeInfoFlags::PpqPosValid | TimeInfoFlags::TempoValid
+                 | TimeInfoFlags::TimeSigValid;
+  }
+
+  intptr_t answer(int32_t opcode, int32_t index, void* ptr, float opt)
+  {
+    switch (static_cast<HostOpcodes>(opcode))
+    {
+      case HostOpcodes::Version:
+        return Constants::ApiVersion;
+      case HostOpcodes::Automate:
+        automation.push_back({position, index, opt});
+        return 0;
+      case HostOpcodes::GetTime:
+        return reinterpret_cast<intptr_t>(&time);
+      case HostOpcodes::GetSampleRate:
+        return intptr_t(sample_rate);
+      case HostOpcodes::GetBlockSize:
+        return block_size;
+      case HostOpcodes::GetCurrentProcessLevel:
+        return static_cast<intptr_t>(ProcessLevels::Offline);
+      case HostOpcodes::UpdateDisplay:
+        display_updates++;
+        return 1;
+      case HostOpcodes::BeginEdit:
+      case HostOpcodes::EndEdit:
+        return 1;
+      case HostOpcodes::GetVendorString:
+        std::strcpy(static_cast<char*>(ptr), "vintage");
+        return 1;
+      case HostOpcodes::GetProductString:
+        std::strcpy(static_cast<char*>(ptr), "vintage test host");
+        return 1;
+      case HostOpcodes::CanDo:
+      {
+        const char* what = static_cast<const char*>(ptr);
+        for (const char* can : {
+                 HostCanDos::SendEvents,
+                 HostCanDos::SendMidiEvent,
+                 HostCanDos::SendTimeInfo,
+                 HostCanDos::Offline,
+                 HostCanDos::StartStopProcess})
+          if (std::strcmp(what, can) == 0)
+            return 1;
+        return 0;
+      }
+      default:
+        return 0;
+    }
+  }
+
+  static intptr_t callback(
+      Effect* effect,
+      int32_t opcode,
+      int32_t index,
+      intptr_t,
+      void* ptr,
+      float opt)
+  {
+    test_host* host
+        = effect && effect->user ? static_cast<test_host*>(effect->user)
+                                 : constructing;
+    if (!host)
+      return opcode == static_cast<int32_t>(HostOpcodes::Version)
+                 ? Constants::ApiVersion
+                 : 0;
+    return host->answer(opcode, index, ptr, opt);
+  }
+
+  static inline thread_local test_host* constructing{};
+
+  std::vector<scheduled_event> events;
+  std::vector<input_signal> inputs;
+  std::vector<std::vector<double>> captured_outputs;
+  TimeInfo time;
+  bool running{};
+};
+
+}
@@ -0,0 +1,491 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/vintage.hpp>
+
+#include <cinttypes>
+
+#if defined(VINTAGE_TRACE)
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+namespace vintage
+{
+
+// Tracing of the interactions with the host.
+//
+// With VINTAGE_TRACE defined, the dispatcher opcodes, process calls and
+// incoming MIDI events of every instance are recorded to a Chrome / Perfetto
+// JSON trace: vintage.<pid>.<n>.trace.json, in the directory given by the
+// VINTAGE_TRACE_DIR environment variable or else the temporary directory.
+//
+// The threads calling into the plug-in only copy a fixed-size record into a
+// ring of their own, without locking, allocating nor formatting; when the
+// ring is full, or all the rings are taken by other threads, the record is
+// dropped and counted. A background thread drains the rings every few
+// milliseconds and formats the trace. It is started, and the file opened,
+// when the plug-in is loaded rather than in a call of the host. The file
+// is a JSON array which is only closed upon unloading; the trace viewers
+// accept it unterminated, e.g. after a crash.
+enum class trace_kind : int32_t
+{
+  dispatch,
+  process,
+  process_double,
+  midi
+};
+
+struct trace_record
+{
+  uint64_t start_ns{};
+  uint64_t duration_ns{};
+  const void* instance{};
+  intptr_t value{};
+  trace_kind kind{};
+  // Opcode for dispatch, frames for process, offset for MIDI
+  int32_t code{};
+  // Index for dispatch, the MIDI bytes for MIDI
+  int32_t index{};
+  float opt{};
+};
+
+#if defined(VINTAGE_TRACE)
+// Written by a single thread, read by the background thread
+struct trace_ring
+{
+  static constexpr uint64_t size = 4096;
+
+  bool push(const trace_record& r) noexcept
+  {
+    const uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= size)
+    {
+      dropped.store(
+          dropped.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+      return false;
+    }
+    records[h % size] = r;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::atomic<bool> claimed{};
+  std::atomic<uint64_t> head{};
+  std::atomic<uint64_t> tail{};
+  std::atomic<uint64_t> dropped{};
+  trace_record records[size];
+};
+
+struct tracer
+{
+  // Threads beyond this number get a ring once another thread exits
+  static constexpr int32_t max_threads = 16;
+
+  // Records between two attempts of a thread without ring to claim one
+  static constexpr uint32_t claim_interval = 256;
+
+  static tracer& instance()
+  {
+    static tracer t;
+    return t;
+  }
+
+  static uint64_t now() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void write(const trace_record& r) noexcept
+  {
+    if (trace_ring* ring = ring_of_this_thread())
+      ring->push(r);
+    else
+      unclaimed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  tracer()
+  {
+    if (!open())
+      return;
+    drainer = std::thread{[this] { run(); }};
+  }
+
+  ~tracer()
+  {
+    if (!drainer.joinable())
+      return;
+    {
+      std::lock_guard lock{mutex};
+      stopping = true;
+    }
+    wake.notify_one();
+    drainer.join();
+    drain();
+    std::fprintf(file, "\n]\n");
+    std::fclose(file);
+  }
+
+  tracer(const tracer&) = delete;
+  tracer& operator=(const tracer&) = delete;
+
+private:
+  // Claimed upon the first record of a thread, released when it exits
+  struct thread_slot
+  {
+    trace_ring* ring{};
+    uint32_t records{};
+    ~thread_slot()
+    {
+      if (ring)
+        ring->claimed.store(false, std::memory_order_release);
+    }
+  };
+
+  trace_ring* ring_of_this_thread() noexcept
+  {
+    static thread_local thread_slot slot;
+    if (!slot.ring && slot.records++ % claim_interval == 0)
+    {
+      for (auto& ring : rings)
+      {
+        bool expected = false;
+        if (ring.claimed.compare_exchange_strong(expected, true))
+        {
+          slot.ring = &ring;
+          break;
+        }
+      }
+    }
+    return slot.ring;
+  }
+
+  bool open()
+  {
+    const char* dir = std::getenv("VINTAGE_TRACE_DIR");
+    std::error_code ec;
+    const std::filesystem::path directory
+        = dir ? std::filesystem::path{dir}
+              : std::filesystem::temp_directory_path(ec);
+#if defined(_WIN32)
+    pid = _getpid();
+#else
+    pid = getpid();
+#endif
+
+    // Each plug-in binary loaded in the process has its own tracer
+    for (int32_t n = 0; n < 1000 && !file; n++)
+    {
+      const std::string name = "vintage." + std::to_string(pid) + "."
+                               + std::to_string(n) + ".trace.json";
+      file = std::fopen((directory / name).string().c_str(), "wx");
+    }
+    if (!file)
+      return false;
+    std::fprintf(file, "[");
+    return true;
+  }
+
+  void run()
+  {
+    std::unique_lock lock{mutex};
+    while (!stopping)
+    {
+      wake.wait_for(lock, std::chrono::milliseconds(20));
+      lock.unlock();
+      drain();
+      lock.lock();
+    }
+  }
+
+  void drain()
+  {
+    for (int32_t t = 0; t < max_threads; t++)
+    {
+      trace_ring& ring = rings[t];
+      const uint64_t head = ring.head.load(std::memory_order_acquire);
+      uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+      for (; tail < head; tail++)
+        print(t, ring.records[tail % trace_ring::size]);
+      ring.tail.store(tail, std::memory_order_release);
+
+      const uint64_t dropped = ring.dropped.load(std::memory_order_relaxed);
+      if (dropped != reported_drops[t])
+        print_dropped(t, reported_drops[t] = dropped);
+    }
+
+    // Records of the threads without ring, on a track of their own
+    const uint64_t dropped = unclaimed.load(std::memory_order_relaxed);
+    if (dropped != reported_unclaimed)
+      print_dropped(max_threads, reported_unclaimed = dropped);
+    std::fflush(file);
+  }
+
+  void print_dropped(int32_t thread, uint64_t records)
+  {
+    separate();
+    std::fprintf(
+        file,
+        R"({"name":"dropped","ph":"C","ts":%.3f,"pid":%d,"tid":%d,)"
+        R"("args":{"records":%llu}})",
+        now() * 1e-3,
+        pid,
+        thread,
+        (unsigned long long)records);
+  }
+
+  void separate()
+  {
+    std::fprintf(file, first ? "\n" : ",\n");
+    first = false;
+  }
+
+  void print(int32_t thread, const trace_record& r)
+  {
+    separate();
+    // Timestamps in µs of the steady clock, shared by all the tracers
+    const double ts = r.start_ns * 1e-3;
+    switch (r.kind)
+    {
+      case trace_kind::dispatch:
+        std::fprintf(
+            file,
+            R"({"name":"%s","cat":"dispatch","ph":"X","ts":%.3f,)"
+            R"("dur":%.3f,"pid":%d,"tid":%d,"args":{"instance":"%p",)"
+            R"("index":%d,"value":%lld,"opt":%g}})",
+            opcode_name(r.code),
+            ts,
+            r.duration_ns * 1e-3,
+            pid,
+            thread,
+            r.instance,
+            r.index,
+            (long long)r.value,
+            std::isfinite(r.opt) ? r.opt : 0.f);
+        break;
+      case trace_kind::process:
+      case trace_kind::process_double:
+        std::fprintf(
+            file,
+            R"({"name":"%s","cat":"process","ph":"X","ts":%.3f,)"
+            R"("dur":%.3f,"pid":%d,"tid":%d,"args":{"instance":"%p",)"
+            R"("frames":%d}})",
+            r.kind == trace_kind::process ? "processReplacing"
+                                          : "processDoubleReplacing",
+            ts,
+            r.duration_ns * 1e-3,
+            pid,
+            thread,
+            r.instance,
+            r.code);
+        break;
+      case trace_kind::midi:
+        std::fprintf(
+            file,
+            R"({"name":"midi %02x","cat":"midi","ph":"i","s":"t",)"
+            R"("ts":%.3f,"pid":%d,"tid":%d,"args":{"instance":"%p",)"
+            R"("bytes":[%d,%d,%d],"offset":%d}})",
+            r.index & 0xF0,
+            ts,
+            pid,
+            thread,
+            r.instance,
+            r.index & 0xFF,
+            (r.index >> 8) & 0xFF,
+            (r.index >> 16) & 0xFF,
+            r.code);
+        break;
+    }
+  }
+
+  static const char* opcode_name(int32_t opcode) noexcept
+  {
+    static constexpr const char* names[]{
+        "Open",
+        "Close",
+        "SetProgram",
+        "GetProgram",
+        "SetProgramName",
+        "GetProgramName",
+        "GetParamLabel",
+        "GetParamDisplay",
+        "GetParamName",
+        "GetVu",
+        "SetSampleRate",
+        "SetBlockSize",
+        "MainsChanged",
+        "EditGetRect",
+        "EditOpen",
+        "EditClose",
+        "EditDraw",
+        "EditMouse",
+        "EditKey",
+        "EditIdle",
+        "EditTop",
+        "EditSleep",
+        "Identify",
+        "GetChunk",
+        "SetChunk",
+        "ProcessEvents",
+        "CanBeAutomated",
+        "String2Parameter",
+        "GetNumProgramCategories",
+        "GetProgramNameIndexed",
+        "CopyProgram",
+        "ConnectInput",
+        "ConnectOutput",
+        "GetInputProperties",
+        "GetOutputProperties",
+        "GetPlugCategory",
+        "GetCurrentPosition",
+        "GetDestinationBuffer",
+        "OfflineNotify",
+        "OfflinePrepare",
+        "OfflineRun",
+        "ProcessVarIo",
+        "SetSpeakerArrangement",
+        "SetBlockSizeAndSampleRate",
+        "SetBypass",
+        "GetEffectName",
+        "GetErrorText",
+        "GetVendorString",
+        "GetProductString",
+        "GetVendorVersion",
+        "VendorSpecific",
+        "CanDo",
+        "GetTailSize",
+        "Idle",
+        "GetIcon",
+        "SetViewPosition",
+        "GetParameterProperties",
+        "KeysRequired",
+        "GetApiVersion",
+        "EditKeyDown",
+        "EditKeyUp",
+        "SetEditKnobMode",
+        "GetMidiProgramName",
+        "GetCurrentMidiProgram",
+        "GetMidiProgramCategory",
+        "HasMidiProgramsChanged",
+        "GetMidiKeyName",
+        "BeginSetProgram",
+        "EndSetProgram",
+        "GetSpeakerArrangement",
+        "ShellGetNextPlugin",
+        "StartProcess",
+        "StopProcess",
+        "SetTotalSampleToProcess",
+        "SetPanLaw",
+        "BeginLoadBank",
+        "BeginLoadProgram",
+        "SetProcessPrecision",
+        "GetNumMidiInputChannels",
+        "GetNumMidiOutputChannels"};
+    static_assert(
+        std::size(names)
+        == std::size_t(EffectOpcodes::GetNumMidiOutputChannels) + 1);
+
+    if (opcode >= 0 && opcode < int32_t(std::size(names)))
+      return names[opcode];
+    return "unknown";
+  }
+
+  trace_ring rings[max_threads];
+  uint64_t reported_drops[max_threads]{};
+  std::atomic<uint64_t> unclaimed{};
+  uint64_t reported_unclaimed{};
+
+  std::FILE* file{};
+  int pid{};
+  bool first{true};
+
+  std::thread drainer;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping{};
+};
+
+// Built upon loading the plug-in rather than by the first traced call
+inline tracer& loaded_tracer = tracer::instance();
+
+// Records a call of the host, for its lifetime
+struct trace_scope
+{
+  trace_scope(
+      const void* instance,
+      trace_kind kind,
+      int32_t code,
+      int32_t index = 0,
+      intptr_t value = 0,
+      float opt = 0.f) noexcept
+      : record{
+          .start_ns = tracer::now(),
+          .instance = instance,
+          .value = value,
+          .kind = kind,
+          .code = code,
+          .index = index,
+          .opt = opt}
+  {
+  }
+
+  ~trace_scope()
+  {
+    record.duration_ns = tracer::now() - record.start_ns;
+    tracer::instance().write(record);
+  }
+
+  trace_scope(const trace_scope&) = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+
+private:
+  trace_record record;
+};
+
+inline void trace_midi(const void* instance, const MidiEvent& ev) noexcept
+{
+  const auto* bytes = reinterpret_cast<const uint8_t*>(ev.midiData);
+  tracer::instance().write(
+      {.start_ns = tracer::now(),
+       .instance = instance,
+       .kind = trace_kind::midi,
+       .code = ev.deltaFrames,
+       .index = bytes[0] | bytes[1] << 8 | bytes[2] << 16});
+}
+#else
+struct trace_scope
+{
+  trace_scope(
+      const void*,
+      trace_kind,
+      int32_t,
+      int32_t = 0,
+      intptr_t = 0,
+      float = 0.f) noexcept
+  {
+  }
+};
+
+inline void trace_midi(const void*, const MidiEvent&) noexcept { }
+#endif
+
+}
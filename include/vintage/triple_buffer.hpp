@@ -0,0 +1,53 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <atomic>
+#include <cinttypes>
+
+namespace vintage
+{
+
+// Hands whole values over from one writer thread to one reader thread,
+// e.g. programs from the dispatcher to the audio thread.
+//
+// The writer and the reader each own a buffer, and swap it with a third,
+// shared one through a single atomic exchange: neither side ever waits for
+// the other, and the reader never sees a half-written value. If several
+// values are published between two reads, the reader gets the latest.
+template <typename V>
+struct triple_buffer
+{
+  // Writer side: fill back(), then publish() it
+  V& back() noexcept { return buffers[back_index]; }
+
+  void publish() noexcept
+  {
+    back_index = shared.exchange(back_index | fresh, std::memory_order_acq_rel)
+                 & index_mask;
+  }
+
+  // Reader side: returns true if front() holds a newly published value
+  bool consume() noexcept
+  {
+    if ((shared.load(std::memory_order_relaxed) & fresh) == 0)
+      return false;
+
+    front_index = shared.exchange(front_index, std::memory_order_acq_rel)
+                  & index_mask;
+    return true;
+  }
+
+  const V& front() const noexcept { return buffers[front_index]; }
+
+private:
+  static constexpr uint8_t index_mask = 3;
+  static constexpr uint8_t fresh = 4;
+
+  V buffers[3]{};
+  uint8_t back_index = 0;
+  alignas(64) std::atomic<uint8_t> shared{1};
+  alignas(64) uint8_t front_index = 2;
+};
+
+}
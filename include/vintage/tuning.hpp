@@ -0,0 +1,287 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <charconv>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vintage
+{
+
+// Frequency of each MIDI note, computed once so that voices only need
+// a table lookup.
+//
+// Defaults to 12-tone equal temperament; microtunings can be loaded from
+// Scala scale (.scl) and keyboard mapping (.kbm) files, as specified in
+// https://www.huygens-fokker.org/scala/scl_format.html and
+// https://www.huygens-fokker.org/scala/help.htm#mappings.
+// Loading parses text and allocates: never do it on the audio thread.
+struct tuning
+{
+  float frequency[128]{};
+
+  tuning() noexcept { equal_temperament(); }
+
+  void equal_temperament(double a4 = 440.) noexcept
+  {
+    for (int32_t n = 0; n < 128; n++)
+      frequency[n] = a4 * std::exp2((n - 69) / 12.);
+  }
+
+  // Takes the contents of the files. Without keyboard mapping, the scale
+  // starts on middle C (note 60) at 261.63 Hz, as in Scala.
+  // On parse errors, returns false and leaves the table unchanged.
+  bool load_scala(std::string_view scl, std::string_view kbm = {})
+  {
+    std::vector<double> cents;
+    if (!parse_scale(scl, cents))
+      return false;
+
+    keyboard_mapping map;
+    if (!kbm.empty() && !parse_mapping(kbm, map))
+      return false;
+
+    const int32_t scale_size = cents.size() - 1;
+    const double period = cents.back();
+
+    // Cents of an unbounded scale degree, repeating the scale every period
+    auto degree_cents = [&](int32_t degree)
+    {
+      const int32_t octave = floor_div(degree, scale_size);
+      return octave * period + cents[degree - octave * scale_size];
+    };
+
+    // Cents of a MIDI note relative to the middle note, or NaN if unmapped
+    const double formal_octave = map.octave_degree > 0
+                                     ? degree_cents(map.octave_degree)
+                                     : period;
+    auto note_cents = [&](int32_t note)
+    {
+      const int32_t offset = note - map.middle_note;
+      if (map.degrees.empty())
+        return degree_cents(offset);
+
+      const int32_t size = map.degrees.size();
+      const int32_t octave = floor_div(offset, size);
+      const int32_t degree = map.degrees[offset - octave * size];
+      if (degree < 0)
+        return double(NAN);
+      return octave * formal_octave + degree_cents(degree);
+    };
+
+    const double reference_cents = note_cents(map.reference_note);
+    if (std::isnan(reference_cents))
+      return false;
+
+    for (int32_t n = 0; n < 128; n++)
+    {
+      const double c = note_cents(n);
+      if (n < map.first_note || n > map.last_note || std::isnan(c))
+        frequency[n] = 0.f;
+      else
+        frequency[n] = map.reference_frequency
+                       * std::exp2((c - reference_cents) / 1200.);
+    }
+    return true;
+  }
+
+  // Same as load_scala but takes file paths; kbm may be null
+  bool load_scala_files(const char* scl, const char* kbm = nullptr)
+  {
+    std::string scl_text, kbm_text;
+    if (!read_file(scl, scl_text))
+      return false;
+    if (kbm && !read_file(kbm, kbm_text))
+      return false;
+    return load_scala(scl_text, kbm_text);
+  }
+
+private:
+  struct keyboard_mapping
+  {
+    int32_t first_note = 0;
+    int32_t last_note = 127;
+    int32_t middle_note = 60;
+    int32_t reference_note = 60;
+    double reference_frequency = 261.6255653005986;
+    int32_t octave_degree = 0;
+
+    // Scale degree of each key, -1 for unmapped keys.
+    // Empty means a linear mapping.
+    std::vector<int32_t> degrees;
+  };
+
+  static int32_t floor_div(int32_t a, int32_t b) noexcept
+  {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+  }
+
+  // Calls func on each line which is not a comment, until it returns false
+  template <typename F>
+  static void for_each_line(std::string_view text, F&& func)
+  {
+    while (!text.empty())
+    {
+      const auto end = text.find('\n');
+      std::string_view line = text.substr(0, end);
+      text.remove_prefix(end == text.npos ? text.size() : end + 1);
+
+      if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+      if (!line.empty() && line.front() == '!')
+        continue;
+      if (!func(line))
+        return;
+    }
+  }
+
+  static std::string_view trim(std::string_view s) noexcept
+  {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+      s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+      s.remove_suffix(1);
+    return s;
+  }
+
+  // Parses the first whitespace-separated token of a line as a number
+  template <typename T>
+  static bool parse_number(std::string_view line, T& value) noexcept
+  {
+    line = trim(line);
+    const auto res
+        = std::from_chars(line.data(), line.data() + line.size(), value);
+    return res.ec == std::errc{};
+  }
+
+  // Pitches are in cents if they contain a period, else they are ratios
+  static bool parse_pitch(std::string_view line, double& cents) noexcept
+  {
+    line = trim(line);
+    line = line.substr(0, line.find_first_of(" \t"));
+    if (line.empty())
+      return false;
+
+    if (line.find('.') != line.npos)
+      return parse_number(line, cents);
+
+    int64_t num{}, den{1};
+    const auto slash = line.find('/');
+    if (!parse_number(line.substr(0, slash), num))
+      return false;
+    if (slash != line.npos && !parse_number(line.substr(slash + 1), den))
+      return false;
+    if (num <= 0 || den <= 0)
+      return false;
+
+    cents = 1200. * std::log2(double(num) / double(den));
+    return true;
+  }
+
+  // Outputs the cents of degrees 0 to N, where N is the period
+  static bool parse_scale(std::string_view scl, std::vector<double>& cents)
+  {
+    int32_t line_index = 0;
+    int32_t count = -1;
+    bool ok = true;
+    cents.assign(1, 0.);
+
+    for_each_line(
+        scl,
+        [&](std::string_view line)
+        {
+          switch (line_index++)
+          {
+            case 0: // Description
+              return true;
+            case 1:
+              ok = parse_number(line, count) && count > 0;
+              return ok;
+            default:
+            {
+              double c{};
+              ok = parse_pitch(line, c);
+              if (ok)
+                cents.push_back(c);
+              return ok && std::ssize(cents) <= count;
+            }
+          }
+        });
+
+    return ok && count > 0 && std::ssize(cents) == count + 1
+           && cents.back() > 0.;
+  }
+
+  static bool parse_mapping(std::string_view kbm, keyboard_mapping& map)
+  {
+    int32_t line_index = 0;
+    int32_t size = -1;
+    bool ok = true;
+
+    for_each_line(
+        kbm,
+        [&](std::string_view line)
+        {
+          switch (line_index++)
+          {
+            case 0:
+              ok = parse_number(line, size) && size >= 0;
+              break;
+            case 1:
+              ok = parse_number(line, map.first_note);
+              break;
+            case 2:
+              ok = parse_number(line, map.last_note);
+              break;
+            case 3:
+              ok = parse_number(line, map.middle_note);
+              break;
+            case 4:
+              ok = parse_number(line, map.reference_note);
+              break;
+            case 5:
+              ok = parse_number(line, map.reference_frequency)
+                   && map.reference_frequency > 0.;
+              break;
+            case 6:
+              ok = parse_number(line, map.octave_degree);
+              break;
+            default:
+            {
+              int32_t degree = -1;
+              if (trim(line).starts_with('x'))
+                map.degrees.push_back(-1);
+              else if ((ok = parse_number(line, degree) && degree >= 0))
+                map.degrees.push_back(degree);
+              break;
+            }
+          }
+          // The seven header lines come first, whatever the size
+          return ok
+                 && (line_index < 7 || std::ssize(map.degrees) < size);
+        });
+
+    return ok && line_index >= 7 && std::ssize(map.degrees) == size;
+  }
+
+  static bool read_file(const char* path, std::string& out)
+  {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f)
+      return false;
+
+    char buffer[4096];
+    std::size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0)
+      out.append(buffer, n);
+    std::fclose(f);
+    return true;
+  }
+};
+
+}
@@ -695,6 +695,20 @@ struct MidiSysexEvent
   intptr_t resvd2{};
 };
 
+// The API reserves the Parameter event type without defining it: this is
+// the layout understood by vintage plug-ins, for sample-accurate automation.
+struct ParameterEvent
+{
+  EventTypes type = EventTypes::Parameter;
+  int32_t byteSize = sizeof(ParameterEvent);
+  int32_t deltaFrames{};
+  EventFlags flags{};
+
+  int32_t index{};
+  float value{};
+  char reserved[8]{};
+};
+
 struct TimeInfo
 {
   double samplePos{};
@@ -0,0 +1,45 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <cinttypes>
+
+namespace vintage
+{
+
+// Structure-of-arrays view over a batch of synthesizer voices.
+//
+// A synth opts into this mode by declaring `static constexpr int32_t lanes`
+// and a kernel:
+//
+//   template <typename sample_t>
+//   void process_voices(
+//       vintage::voice_lanes<channels, lanes>& voices,
+//       sample_t** outputs,
+//       int32_t frames);
+//
+// The framework gathers up to `lanes` active voices in each batch, calls the
+// kernel, then scatters the state back to the voices. Each field is a
+// contiguous array so that loops over the lanes map onto SIMD registers.
+//
+// Unused lanes have a zero volume and frequency: kernels can always process
+// the whole width instead of branching on `count`.
+template <int32_t Channels, int32_t Width>
+struct voice_lanes
+{
+  static constexpr int32_t channels = Channels;
+  static constexpr int32_t width = Width;
+
+  // Number of lanes which hold an actual voice
+  int32_t count{};
+
+  alignas(64) float frequency[Width]{};
+  alignas(64) float volume[Width]{};
+  alignas(64) float phase[Width]{};
+  alignas(64) float pan[Channels][Width]{};
+  alignas(64) int32_t elapsed[Width]{};
+  alignas(64) int32_t release_frame[Width]{};
+  alignas(64) bool recycle[Width]{};
+};
+
+}
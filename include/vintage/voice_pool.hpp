@@ -0,0 +1,85 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <cinttypes>
+#include <memory>
+#include <utility>
+
+namespace vintage
+{
+
+// Fixed-capacity storage for synthesizer voices.
+//
+// All the memory is allocated in reserve(), which must be called outside of
+// the audio thread. Afterwards, acquiring and recycling a voice are O(1) and
+// never touch the allocator.
+//
+// Voices live in stable slots; the active ones are additionally tracked
+// in a dense array of slot indices so that iterating over them does not
+// have to skip holes. Recycling swaps the last active voice into the freed
+// position, thus the iteration order is not the allocation order.
+template <typename Voice>
+struct voice_pool
+{
+  void reserve(int32_t count)
+  {
+    slots = std::make_unique<Voice[]>(count);
+    free_slots = std::make_unique<int32_t[]>(count);
+    active_slots = std::make_unique<int32_t[]>(count);
+    capacity = count;
+    clear();
+  }
+
+  // Drops all the active voices
+  void clear() noexcept
+  {
+    for (int32_t i = 0; i < capacity; i++)
+      free_slots[i] = capacity - 1 - i;
+    free_count = capacity;
+    active_count = 0;
+  }
+
+  // Returns nullptr if there is no room left for a new voice
+  Voice* acquire(Voice&& init) noexcept
+  {
+    if (free_count == 0)
+      return nullptr;
+
+    const int32_t slot = free_slots[--free_count];
+    active_slots[active_count++] = slot;
+
+    Voice& v = slots[slot];
+    v = std::move(init);
+    return &v;
+  }
+
+  // Index is the position in [0; size()), not the slot
+  void recycle(int32_t index) noexcept
+  {
+    free_slots[free_count++] = active_slots[index];
+    active_slots[index] = active_slots[--active_count];
+  }
+
+  Voice& operator[](int32_t index) noexcept
+  {
+    return slots[active_slots[index]];
+  }
+  const Voice& operator[](int32_t index) const noexcept
+  {
+    return slots[active_slots[index]];
+  }
+
+  int32_t size() const noexcept { return active_count; }
+  bool empty() const noexcept { return active_count == 0; }
+  bool full() const noexcept { return free_count == 0; }
+
+  std::unique_ptr<Voice[]> slots;
+  std::unique_ptr<int32_t[]> free_slots;
+  std::unique_ptr<int32_t[]> active_slots;
+  int32_t capacity{};
+  int32_t free_count{};
+  int32_t active_count{};
+};
+
+}
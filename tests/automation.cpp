@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <vector>
+
+namespace
+{
+using vintage::test::constant_synth;
+using vintage::test::entry;
+
+// Effects: the gain changes at the frame of each automation point, also in
+// later blocks
+void effect_automation()
+{
+  vintage::test_host host{entry<vintage::test::gain>, 44100., 256};
+  host.input(0, std::vector<double>(768, 1.));
+  host.automate(100, 0, 0.5f);
+  host.automate(300, 0, 0.25f);
+  host.automate(600, 0, 0.75f);
+  host.render(768);
+
+  const auto& out = host.captured(0);
+  VINTAGE_CHECK(out[99] == 1.);
+  VINTAGE_CHECK(out[100] == 0.5);
+  VINTAGE_CHECK(out[299] == 0.5);
+  VINTAGE_CHECK(out[300] == 0.25);
+  VINTAGE_CHECK(out[599] == 0.25);
+  VINTAGE_CHECK(out[600] == 0.75);
+  VINTAGE_CHECK(out[767] == 0.75);
+}
+
+// Synths: same, and a note starting on the frame of a parameter change
+// sounds with the new value from its first frame
+void synth_automation()
+{
+  vintage::test_host host{entry<constant_synth>, 44100., 256};
+  host.note_on(50, 60, 100);
+  host.automate(100, 0, 0.5f);
+  host.automate(400, 0, 0.25f);
+  host.note_off(400, 60);
+  host.note_on(400, 64, 100);
+  host.render(512);
+
+  // Each note also starts unison voices: the output is the level times
+  // the voices of a note
+  const auto& out = host.captured(0);
+  const double voices = out[50];
+  VINTAGE_CHECK(out[49] == 0.);
+  VINTAGE_CHECK(voices >= 1.);
+  VINTAGE_CHECK(out[99] == voices);
+  VINTAGE_CHECK(out[100] == 0.5 * voices);
+  VINTAGE_CHECK(out[399] == 0.5 * voices);
+
+  // The first note stops, the second starts with the new level
+  VINTAGE_CHECK(out[400] == 0.25 * voices);
+  VINTAGE_CHECK(out[511] == 0.25 * voices);
+}
+}
+
+int main()
+{
+  effect_automation();
+  synth_automation();
+  return vintage::test::result();
+}
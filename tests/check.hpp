@@ -0,0 +1,116 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/audio_effect.hpp>
+#include <vintage/polyphonic_synth.hpp>
+
+#include <cstdio>
+
+namespace vintage::test
+{
+
+inline int& failures() noexcept
+{
+  static int count = 0;
+  return count;
+}
+
+// Exit status of a test executable
+inline int result() noexcept
+{
+  if (failures() != 0)
+    std::fprintf(stderr, "%d check(s) failed\n", failures());
+  return failures() == 0 ? 0 : 1;
+}
+
+// Metadata of the plug-ins of the tests. They derive from it and declare
+// what they test, overriding the category for synths or the unique id when
+// it matters.
+struct plugin
+{
+  static constexpr auto name = "Test";
+  static constexpr auto vendor = "vintage";
+  static constexpr auto product = "1.0";
+  static constexpr auto category = vintage::PlugCategory::Effect;
+  static constexpr auto version = 1;
+  static constexpr auto unique_id = 0x74657374; // 'test'
+  static constexpr auto channels = 1;
+};
+
+// Output = gain * input, so that the gain applied to each frame shows
+struct gain : plugin
+{
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Gain"; }
+      float value{1.0};
+    } gain;
+  } parameters;
+
+  auto process(vintage::sample auto input)
+  {
+    return parameters.gain.value * input;
+  }
+};
+
+// Synth whose voices output the level until released, so that the output
+// shows when each note sounds and the level it sees
+struct constant_synth : plugin
+{
+  static constexpr auto category = vintage::PlugCategory::Synth;
+
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Level"; }
+      float value{1.};
+    } level;
+  } parameters;
+
+  struct voice
+  {
+    float frequency{};
+    float volume{};
+    float pan[channels]{};
+    int32_t elapsed{};
+    int32_t release_frame{-1};
+    bool recycle{};
+
+    template <typename sample_t>
+    void process(constant_synth& synth, sample_t** outputs, int32_t frames)
+    {
+      for (int32_t i = 0; i < frames; i++)
+        if (release_frame < 0 || elapsed + i < release_frame)
+          outputs[0][i] += synth.parameters.level.value;
+      elapsed += frames;
+    }
+  };
+};
+
+// Entry point of a test plug-in, for test_host
+template <typename T>
+vintage::Effect* entry(vintage::HostCallback cb)
+{
+  if constexpr (T::category == vintage::PlugCategory::Synth)
+    return new vintage::PolyphonicSynthesizer<T>{cb};
+  else
+    return new vintage::SimpleAudioEffect<T>{cb};
+}
+
+}
+
+// Reports a failed condition and carries on, so that a run lists them all
+#define VINTAGE_CHECK(cond)                                                  \
+  do                                                                         \
+  {                                                                          \
+    if (!(cond))                                                             \
+    {                                                                        \
+      std::fprintf(                                                          \
+          stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+      vintage::test::failures()++;                                           \
+    }                                                                        \
+  } while (0)
@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <cstring>
+#include <vector>
+
+struct Stateful : vintage::test::plugin
+{
+  static constexpr auto unique_id = 0x73746174;
+
+  int32_t current_program = 0;
+
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Gain"; }
+      float value{1.0};
+    } gain;
+    struct
+    {
+      constexpr auto name() const noexcept { return "Mix"; }
+      float value{0.5};
+    } mix;
+  } parameters;
+
+  struct
+  {
+    std::string_view name;
+    decltype(Stateful::parameters) parameters;
+  } programs[3]{
+      {.name{"A"}, .parameters{.gain = {1.0}, .mix = {0.5}}},
+      {.name{"B"}, .parameters{.gain = {0.5}, .mix = {0.5}}},
+      {.name{"C"}, .parameters{.gain = {0.25}, .mix = {0.5}}},
+  };
+
+  struct
+  {
+    int32_t mode{1};
+    float offset{0.f};
+  } state;
+
+  // Shows the gain and the state in the output
+  auto process(vintage::sample auto input)
+  {
+    return parameters.gain.value * input + state.offset;
+  }
+};
+
+namespace
+{
+using effect_type = vintage::SimpleAudioEffect<Stateful>;
+
+constexpr auto entry = vintage::test::entry<Stateful>;
+
+std::vector<char> get_chunk(vintage::test_host& host)
+{
+  void* data = nullptr;
+  const intptr_t size
+      = host.dispatch(vintage::EffectOpcodes::GetChunk, 0, 0, &data);
+  const char* p = static_cast<const char*>(data);
+  return size > 0 ? std::vector<char>(p, p + size) : std::vector<char>{};
+}
+
+intptr_t set_chunk(vintage::test_host& host, std::vector<char> chunk)
+{
+  return host.dispatch(
+      vintage::EffectOpcodes::SetChunk, 0, intptr_t(chunk.size()), chunk.data());
+}
+
+// The state is written after the 6 header fields, the parameters and the
+// state size
+constexpr std::size_t state_offset = 6 * 4 + 2 * 4 + 4;
+
+std::vector<char> modified_chunk()
+{
+  vintage::test_host source{entry};
+  vintage::Effect& e = *source.effect;
+  source.dispatch(vintage::EffectOpcodes::SetProgram, 0, 2);
+  e.setParameter(&e, 1, 0.75f);
+
+  std::vector<char> chunk = get_chunk(source);
+  const decltype(Stateful::state) state{.mode = 3, .offset = 0.125f};
+  std::memcpy(chunk.data() + state_offset, &state, sizeof(state));
+  return chunk;
+}
+
+// What SetChunk restores is saved by GetChunk right away, without any block
+// processed in between
+void round_trip()
+{
+  const std::vector<char> chunk = modified_chunk();
+
+  vintage::test_host host{entry, 44100., 64};
+  VINTAGE_CHECK(set_chunk(host, chunk) == 1);
+  VINTAGE_CHECK(get_chunk(host) == chunk);
+  VINTAGE_CHECK(host.dispatch(vintage::EffectOpcodes::GetProgram) == 2);
+
+  // Then the audio thread picks it up
+  host.input(0, std::vector<double>(64, 1.));
+  host.render(64);
+  VINTAGE_CHECK(host.captured(0).back() == 0.25 + 0.125);
+  auto& impl = static_cast<effect_type*>(host.effect)->implementation;
+  VINTAGE_CHECK(impl.state.mode == 3);
+  VINTAGE_CHECK(impl.parameters.mix.value == 0.75f);
+  VINTAGE_CHECK(get_chunk(host) == chunk);
+}
+
+void rejected_chunks()
+{
+  vintage::test_host host{entry};
+  const std::vector<char> initial = get_chunk(host);
+  std::vector<char> chunk = modified_chunk();
+
+  // Another plug-in
+  std::vector<char> other = chunk;
+  other[8] ^= 1;
+  VINTAGE_CHECK(set_chunk(host, other) == 0);
+  // Truncated in the parameters
+  VINTAGE_CHECK(set_chunk(host, {chunk.begin(), chunk.begin() + 28}) == 0);
+  VINTAGE_CHECK(get_chunk(host) == initial);
+
+  // A program index out of range keeps the current program
+  chunk[16] = 7;
+  VINTAGE_CHECK(set_chunk(host, chunk) == 1);
+  VINTAGE_CHECK(host.dispatch(vintage::EffectOpcodes::GetProgram) == 0);
+}
+
+// Chunks saved with fewer parameters leave the others unchanged
+void fewer_parameters()
+{
+  vintage::test_host host{entry};
+  vintage::Effect& e = *host.effect;
+  e.setParameter(&e, 1, 0.2f);
+
+  std::vector<char> chunk = modified_chunk();
+  chunk[20] = 1;
+  chunk.erase(chunk.begin() + 28, chunk.begin() + 32);
+  VINTAGE_CHECK(set_chunk(host, chunk) == 1);
+  VINTAGE_CHECK(e.getParameter(&e, 0) == 0.25f);
+  VINTAGE_CHECK(e.getParameter(&e, 1) == 0.2f);
+}
+}
+
+int main()
+{
+  round_trip();
+  rejected_chunks();
+  fewer_parameters();
+  return vintage::test::result();
+}
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/dsp/envelope.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+using vintage::dsp::envelope;
+
+bool near(float a, float b, float tolerance = 1e-5f)
+{
+  return std::abs(a - b) <= tolerance;
+}
+
+// Renders `frames` gains in blocks of `block` frames
+std::vector<float> render(envelope& env, int32_t frames, int32_t block)
+{
+  std::vector<float> gains(frames);
+  for (int32_t i = 0; i < frames; i += block)
+    env.process(gains.data() + i, std::min(block, frames - i));
+  return gains;
+}
+
+envelope adsr()
+{
+  envelope env;
+  env.attack = 100.f;
+  env.decay = 200.f;
+  env.sustain = 0.5f;
+  env.release = 300.f;
+  return env;
+}
+
+// Linear attack up to full level, exponential decay to the sustain level,
+// reaching -60 dB of the distance to it at the end of the segment
+void attack_decay_sustain()
+{
+  envelope env = adsr();
+  env.start();
+  const std::vector<float> gains = render(env, 400, 64);
+
+  for (int32_t i = 0; i < 100; i++)
+    VINTAGE_CHECK(near(gains[i], float(i + 1) / 100.f));
+  VINTAGE_CHECK(gains[99] == 1.f);
+
+  for (int32_t i = 100; i < 300; i++)
+  {
+    VINTAGE_CHECK(gains[i] < gains[i - 1]);
+    VINTAGE_CHECK(gains[i] > 0.5f);
+  }
+  VINTAGE_CHECK(near(gains[299] - 0.5f, 0.5f * 1e-3f, 1e-6f));
+
+  for (int32_t i = 300; i < 400; i++)
+    VINTAGE_CHECK(gains[i] == 0.5f);
+  VINTAGE_CHECK(env.state() == envelope::stage::sustain);
+
+  // The sustain level is read while sustaining
+  env.sustain = 0.25f;
+  VINTAGE_CHECK(render(env, 16, 16).back() == 0.25f);
+}
+
+// Exponential release to silence, after which the voice can be recycled
+void release()
+{
+  envelope env = adsr();
+  env.start();
+  render(env, 400, 64);
+  env.stop();
+
+  const std::vector<float> gains = render(env, 300, 64);
+  for (int32_t i = 1; i < 300; i++)
+    VINTAGE_CHECK(gains[i] < gains[i - 1]);
+  VINTAGE_CHECK(near(gains[298], 0.25f * 1e-3f, 1e-3f));
+  VINTAGE_CHECK(env.recycle());
+  VINTAGE_CHECK(render(env, 16, 16).back() == 0.f);
+
+  // Released during the attack: the release starts from the current level
+  env = adsr();
+  env.start();
+  render(env, 50, 50);
+  env.stop();
+  const float first = render(env, 1, 1).front();
+  VINTAGE_CHECK(near(first, 0.5f * std::exp(-6.907755f / 300.f)));
+  VINTAGE_CHECK(!env.recycle());
+}
+
+// The segments do not depend on how the host splits the blocks
+void block_sizes()
+{
+  envelope whole = adsr();
+  envelope split = adsr();
+  whole.start();
+  split.start();
+  const std::vector<float> a = render(whole, 400, 400);
+  const std::vector<float> b = render(split, 400, 7);
+  for (int32_t i = 0; i < 400; i++)
+    VINTAGE_CHECK(near(a[i], b[i]));
+}
+
+// Each lane follows the closed form of its voice: the linear attack, then
+// the linear release from full level at the release frame
+void lanes()
+{
+  constexpr int32_t width = 8;
+  const int32_t elapsed[width]{0, 50, 200, 200, 400, 400, 0, 1000};
+  const int32_t release_frame[width]{-1, -1, -1, 150, 300, 100, -1, 500};
+
+  vintage::dsp::lane_envelope<width> env;
+  env.attack = 100.f;
+  env.release = 200.f;
+  env.prepare(elapsed, release_frame);
+
+  for (int32_t l = 0; l < width; l++)
+  {
+    for (int32_t i = 0; i < 64; i++)
+    {
+      const float t = float(elapsed[l] + i);
+      float expected = std::min(1.f, t / 100.f);
+      if (release_frame[l] >= 0)
+        expected = std::min(expected, 1.f - (t - release_frame[l]) / 200.f);
+      expected = std::max(0.f, expected);
+      VINTAGE_CHECK(near(env.gain(l, float(i)), expected));
+    }
+  }
+
+  VINTAGE_CHECK(!env.finished(1000, -1));
+  VINTAGE_CHECK(!env.finished(499, 300));
+  VINTAGE_CHECK(env.finished(500, 300));
+}
+}
+
+int main()
+{
+  attack_decay_sustain();
+  release();
+  block_sizes();
+  lanes();
+  return vintage::test::result();
+}
@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <utility>
+#include <vector>
+
+// Voices which play nothing: the tests look at which notes are held
+struct Pulse : vintage::test::plugin
+{
+  static constexpr auto category = vintage::PlugCategory::Synth;
+
+  int32_t sample_rate = 0;
+  int32_t buffer_size = 0;
+
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Level"; }
+      float value{0.};
+    } level;
+  } parameters;
+
+  struct voice
+  {
+    float frequency{};
+    float volume{};
+    float pan[channels]{};
+    int32_t elapsed{};
+    int32_t release_frame{-1};
+    bool recycle{};
+
+    template <typename sample_t>
+    void process(Pulse&, sample_t**, int32_t frames)
+    {
+      elapsed += frames;
+    }
+  };
+};
+
+namespace
+{
+using synth = vintage::PolyphonicSynthesizer<Pulse>;
+
+constexpr auto entry = vintage::test::entry<Pulse>;
+constexpr auto constant_entry
+    = vintage::test::entry<vintage::test::constant_synth>;
+
+synth& instance(vintage::test_host& host)
+{
+  return *static_cast<synth*>(host.effect);
+}
+
+int32_t held_notes(const synth& s)
+{
+  int32_t held = 0;
+  for (int32_t i = 0; i < s.voices.size(); i++)
+    held += !s.voices[i].released;
+  return held;
+}
+
+void sorted_by_offset()
+{
+  vintage::event_buffer<vintage::MidiEvent, 8> buffer;
+  const int32_t offsets[]{5, 1, 5, 0, 3, 5};
+  for (int32_t i = 0; i < 6; i++)
+  {
+    vintage::MidiEvent e;
+    e.deltaFrames = offsets[i];
+    e.midiData[1] = char(i);
+    VINTAGE_CHECK(buffer.push(e));
+  }
+
+  // Same offset: arrival order
+  const int32_t order[]{3, 1, 4, 0, 2, 5};
+  for (int32_t i = 0; i < 6; i++)
+    VINTAGE_CHECK(buffer.events[i].midiData[1] == order[i]);
+
+  buffer.pop_front(2);
+  VINTAGE_CHECK(buffer.size() == 4);
+  VINTAGE_CHECK(buffer.events[0].midiData[1] == 4);
+}
+
+// First frame of each run of non-zero output, and the frame after it
+using runs = std::vector<std::pair<int32_t, int32_t>>;
+
+runs sounding(const std::vector<double>& out)
+{
+  runs r;
+  for (int32_t i = 0; i < std::ssize(out); i++)
+  {
+    if (out[i] == 0.)
+      continue;
+    if (r.empty() || r.back().second != i)
+      r.push_back({i, i});
+    r.back().second = i + 1;
+  }
+  return r;
+}
+
+// Notes start and stop at their deltaFrames, not at the start of a block
+void notes_at_their_frame()
+{
+  vintage::test_host host{constant_entry, 44100., 512};
+  host.note_on(100, 60, 100);
+  host.note_off(300, 60);
+  host.render(512);
+
+  const auto& out = host.captured(0);
+  VINTAGE_CHECK(out[99] == 0.);
+  VINTAGE_CHECK(out[100] != 0.);
+  VINTAGE_CHECK(out[299] != 0.);
+  VINTAGE_CHECK(out[300] == 0.);
+  VINTAGE_CHECK(sounding(out) == (runs{{100, 300}}));
+}
+
+// A note held across blocks, and a note starting in a later block
+void notes_across_blocks()
+{
+  vintage::test_host host{constant_entry, 44100., 512};
+  host.note_on(500, 60, 100);
+  host.note_off(700, 60);
+  host.note_on(1100, 64, 100);
+  host.note_off(1300, 64);
+  host.render(1536);
+
+  const runs expected{{500, 700}, {1100, 1300}};
+  VINTAGE_CHECK(sounding(host.captured(0)) == expected);
+}
+
+// More events in a block than the queues hold: the notes released in the
+// block are all released, whichever order the events are applied in
+void overflow_keeps_order()
+{
+  vintage::test_host host{entry, 44100., 1024};
+
+  // 400 controller changes, then 64 note-ons and their 64 note-offs: the
+  // last note-offs do not fit
+  for (int32_t i = 0; i < 400; i++)
+    host.midi(i, 0xB0, 1, i % 128);
+  for (int32_t n = 0; n < 64; n++)
+    host.note_on(450 + n, n, 100);
+  for (int32_t n = 0; n < 64; n++)
+    host.note_off(600 + n, n);
+
+  // 600 automation points on the same block: the last one wins
+  for (int32_t i = 0; i < 600; i++)
+    host.automate(i, 0, i / 1000.f);
+
+  host.render(1024);
+  VINTAGE_CHECK(held_notes(instance(host)) == 0);
+  VINTAGE_CHECK(instance(host).voices.size() > 0);
+  VINTAGE_CHECK(instance(host).implementation.parameters.level.value
+                == 599 / 1000.f);
+}
+
+// Events received before the host suspends processing are not applied once
+// it resumes
+void reset_clears_events()
+{
+  vintage::test_host host{entry, 44100., 512};
+  host.start();
+
+  vintage::MidiEvent note;
+  note.deltaFrames = 10;
+  note.midiData[0] = char(0x90);
+  note.midiData[1] = 60;
+  note.midiData[2] = 100;
+  vintage::Events list{.numEvents = 1};
+  list.events[0] = reinterpret_cast<vintage::Event*>(&note);
+  host.dispatch(vintage::EffectOpcodes::ProcessEvents, 0, 0, &list);
+
+  host.stop();
+  host.render(512);
+  VINTAGE_CHECK(instance(host).voices.empty());
+}
+}
+
+int main()
+{
+  sorted_by_offset();
+  notes_at_their_frame();
+  notes_across_blocks();
+  overflow_keeps_order();
+  reset_clears_events();
+  return vintage::test::result();
+}
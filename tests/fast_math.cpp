@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/dsp/fast_math.hpp>
+
+#include <cmath>
+
+namespace
+{
+using namespace vintage::dsp;
+
+constexpr int32_t points = 1 << 21;
+
+// Max error of an approximation against libm evaluated in double, over a
+// uniform grid of [lo, hi]. The input is rounded to T before both, so that
+// only the error of the approximation shows.
+template <typename T>
+double max_error(double lo, double hi, auto fast, auto exact, bool relative)
+{
+  double error = 0.;
+  for (int32_t i = 0; i <= points; i++)
+  {
+    const T x = T(lo + (hi - lo) * i / points);
+    const double expected = exact(double(x));
+    double e = std::abs(double(fast(x)) - expected);
+    if (relative && expected != 0.)
+      e /= std::abs(expected);
+    error = std::max(error, e);
+  }
+  return error;
+}
+
+template <typename T>
+double absolute(double lo, double hi, auto fast, auto exact)
+{
+  return max_error<T>(lo, hi, fast, exact, false);
+}
+
+template <typename T>
+double relative(double lo, double hi, auto fast, auto exact)
+{
+  return max_error<T>(lo, hi, fast, exact, true);
+}
+
+// The bounds documented in vintage/dsp/fast_math.hpp
+template <typename T>
+void documented_bounds()
+{
+  constexpr bool single = sizeof(T) == 4;
+  const auto tanh = [](T x) { return fast_tanh(x); };
+  const auto sin = [](T x) { return fast_sin(x); };
+  const auto cos = [](T x) { return fast_cos(x); };
+  const auto exp2 = [](T x) { return fast_exp2(x); };
+  const auto log2 = [](T x) { return fast_log2(x); };
+  const auto libm_tanh = [](double x) { return std::tanh(x); };
+  const auto libm_sin = [](double x) { return std::sin(x); };
+  const auto libm_cos = [](double x) { return std::cos(x); };
+  const auto libm_exp2 = [](double x) { return std::exp2(x); };
+  const auto libm_log2 = [](double x) { return std::log2(x); };
+
+  // Past the clamp at 10 as well
+  VINTAGE_CHECK(
+      absolute<T>(-12., 12., tanh, libm_tanh) <= (single ? 2.1e-7 : 4e-9));
+
+  VINTAGE_CHECK(
+      absolute<T>(-7., 7., sin, libm_sin) <= (single ? 2.2e-7 : 6e-8));
+  VINTAGE_CHECK(
+      absolute<T>(-7., 7., cos, libm_cos) <= (single ? 4.4e-7 : 6e-8));
+  if constexpr (single)
+    VINTAGE_CHECK(absolute<T>(-1e4, 1e4, sin, libm_sin) <= 1.3e-3);
+
+  // Exponents of the normal numbers
+  const double lowest = single ? -126. : -1022.;
+  const double highest = single ? 127. : 1023.;
+  VINTAGE_CHECK(
+      relative<T>(lowest, highest, exp2, libm_exp2)
+      <= (single ? 2.5e-7 : 1.7e-7));
+
+  // Over the normal numbers, swept along their exponent, and densely around
+  // 1 where log2 goes through 0
+  const auto power = [](double e) { return T(std::exp2(e)); };
+  const auto log2_of_exp2 = [&](T e) { return fast_log2(power(e)); };
+  const auto exact = [&](double e) { return std::log2(double(power(e))); };
+  if constexpr (single)
+  {
+    VINTAGE_CHECK(relative<T>(lowest, highest, log2_of_exp2, exact) <= 3e-7);
+    VINTAGE_CHECK(relative<T>(0.5, 2., log2, libm_log2) <= 3e-7);
+  }
+  else
+  {
+    VINTAGE_CHECK(absolute<T>(lowest, highest, log2_of_exp2, exact) <= 1.1e-9);
+    VINTAGE_CHECK(absolute<T>(0.5, 2., log2, libm_log2) <= 1.1e-9);
+  }
+}
+}
+
+int main()
+{
+  documented_bounds<float>();
+  documented_bounds<double>();
+  return vintage::test::result();
+}
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <vector>
+
+namespace
+{
+// Out of range indices, from the host or in automation events, are ignored
+template <typename T>
+void out_of_range_indices()
+{
+  vintage::test_host host{vintage::test::entry<T>, 44100., 64};
+  vintage::Effect& e = *host.effect;
+  const float before = e.getParameter(&e, 0);
+
+  for (int32_t index : {-1, -1000, e.numParams, e.numParams + 1000})
+  {
+    e.setParameter(&e, index, 0.25f);
+    host.automate(10, index, 0.25f);
+    VINTAGE_CHECK(e.getParameter(&e, index) == 0.f);
+  }
+  host.input(0, std::vector<double>(64, 1.));
+  host.render(64);
+
+  VINTAGE_CHECK(e.getParameter(&e, 0) == before);
+}
+}
+
+int main()
+{
+  out_of_range_indices<vintage::test::gain>();
+  out_of_range_indices<vintage::test::constant_synth>();
+  return vintage::test::result();
+}
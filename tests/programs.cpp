@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+struct Gain : vintage::test::gain
+{
+  int32_t current_program = 0;
+
+  struct
+  {
+    std::string_view name;
+    decltype(Gain::parameters) parameters;
+  } programs[2]{
+      {.name{"Unity"}, .parameters{.gain = {1.0}}},
+      {.name{"Quarter"}, .parameters{.gain = {0.25}}},
+  };
+};
+
+namespace
+{
+constexpr auto entry = vintage::test::entry<Gain>;
+
+// Gain applied to the next block
+double rendered_gain(vintage::test_host& host)
+{
+  host.clear_captured();
+  host.input(0, std::vector<double>(64, 1.));
+  host.render(64);
+  return host.captured(0).back();
+}
+
+// A value set before the program change, but not yet applied, does not
+// override the program
+void program_after_parameter()
+{
+  vintage::test_host host{entry, 44100., 64};
+  vintage::Effect& e = *host.effect;
+  e.setParameter(&e, 0, 0.9f);
+  host.dispatch(vintage::EffectOpcodes::SetProgram, 0, 1);
+  VINTAGE_CHECK(rendered_gain(host) == 0.25);
+  VINTAGE_CHECK(e.getParameter(&e, 0) == 0.25f);
+}
+
+// A value set after the program change applies on top of it
+void parameter_after_program()
+{
+  vintage::test_host host{entry, 44100., 64};
+  vintage::Effect& e = *host.effect;
+  host.dispatch(vintage::EffectOpcodes::SetProgram, 0, 1);
+  e.setParameter(&e, 0, 0.5f);
+  VINTAGE_CHECK(rendered_gain(host) == 0.5);
+
+  // Several program changes between two blocks: the latest wins
+  host.dispatch(vintage::EffectOpcodes::SetProgram, 0, 0);
+  e.setParameter(&e, 0, 0.75f);
+  host.dispatch(vintage::EffectOpcodes::SetProgram, 0, 1);
+  VINTAGE_CHECK(rendered_gain(host) == 0.25);
+}
+}
+
+int main()
+{
+  program_after_parameter();
+  parameter_after_program();
+  return vintage::test::result();
+}
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Detuned sines, rendered by the render pool when there are enough voices
+struct Chorus : vintage::test::plugin
+{
+  static constexpr auto category = vintage::PlugCategory::Synth;
+  static constexpr auto channels = 2;
+  static constexpr int32_t render_threads = 3;
+
+  int32_t sample_rate = 0;
+  int32_t buffer_size = 0;
+
+  struct
+  {
+    struct
+    {
+      constexpr auto name() const noexcept { return "Volume"; }
+      float value{0.1};
+    } volume;
+  } parameters;
+
+  struct voice
+  {
+    float frequency{};
+    float volume{};
+    float pan[channels]{};
+    int32_t elapsed{};
+    int32_t release_frame{-1};
+    bool recycle{};
+    double phase{};
+
+    template <typename sample_t>
+    void process(Chorus& synth, sample_t** outputs, int32_t frames)
+    {
+      const double step = 2. * vintage::pi * frequency / synth.sample_rate;
+      const float gain = volume * synth.parameters.volume.value;
+      for (int32_t i = 0; i < frames; i++)
+      {
+        const float released
+            = release_frame >= 0 && elapsed + i >= release_frame ? 0.5f : 1.f;
+        const sample_t s = sample_t(gain * released * std::sin(phase));
+        outputs[0][i] += s;
+        outputs[1][i] -= s;
+        phase += step;
+      }
+      elapsed += frames;
+    }
+  };
+};
+
+namespace
+{
+using synth = vintage::PolyphonicSynthesizer<Chorus>;
+
+constexpr auto entry = vintage::test::entry<Chorus>;
+
+// Every job runs exactly once, whatever the number of jobs
+void every_job_once()
+{
+  vintage::render_pool pool{3};
+  std::vector<int32_t> runs(200);
+  bool ok = true;
+  for (int32_t round = 0; round < 500; round++)
+  {
+    const int32_t count = 1 + round % 200;
+    std::fill(runs.begin(), runs.end(), 0);
+    pool.run(count, [&runs](int32_t j) { runs[j]++; });
+    for (int32_t j = 0; j < 200; j++)
+      ok &= runs[j] == (j < count ? 1 : 0);
+  }
+  VINTAGE_CHECK(ok);
+}
+
+std::vector<double> render(bool pooled, vintage::ProcessPrecision precision)
+{
+  vintage::test_host host{entry, 48000., 512};
+  host.precision = precision;
+
+  // Forced either way, whatever the number of cores of the machine
+  auto& s = *static_cast<synth*>(host.effect);
+  if (pooled)
+    s.pool = std::make_unique<vintage::render_pool>(3);
+  else
+    s.pool.reset();
+
+  // Up to 96 voices, some released, over blocks of varying voice counts
+  for (int32_t n = 0; n < 96; n++)
+    host.note_on(37 * n, 24 + n, 40 + n % 80);
+  for (int32_t n = 0; n < 96; n += 3)
+    host.note_off(4000 + 11 * n, 24 + n);
+  host.render(12000);
+
+  std::vector<double> out = host.captured(0);
+  out.insert(out.end(), host.captured(1).begin(), host.captured(1).end());
+  return out;
+}
+
+// The pool changes who renders the voices, not the output
+void pooled_matches_serial()
+{
+  for (auto precision :
+       {vintage::ProcessPrecision::Single, vintage::ProcessPrecision::Double})
+  {
+    const auto serial = render(false, precision);
+    const auto pooled = render(true, precision);
+    VINTAGE_CHECK(serial.size() == pooled.size());
+    VINTAGE_CHECK(serial == pooled);
+
+    double energy = 0.;
+    for (double x : serial)
+      energy += x * x;
+    VINTAGE_CHECK(energy > 1.);
+  }
+}
+}
+
+int main()
+{
+  every_job_once();
+  pooled_matches_serial();
+  return vintage::test::result();
+}
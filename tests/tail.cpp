@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <vector>
+
+// Memoryless, but oversampled: the output lags the input by the latency of
+// the resampling filters, which also ring afterwards
+struct Oversampled : vintage::test::gain
+{
+  static constexpr int32_t oversampling = 4;
+};
+
+// Declaring a tail lets the wrapper skip silent blocks
+struct Skipping : Oversampled
+{
+  static constexpr int32_t tail_frames = 0;
+};
+
+namespace
+{
+using vintage::test::entry;
+
+std::vector<double> impulse_response(vintage::test_host& host)
+{
+  std::vector<double> impulse(64, 0.);
+  impulse.back() = 1.;
+  host.input(0, impulse);
+  host.render(1024);
+  return host.captured(0);
+}
+
+// Skipping the silent blocks loses nothing of the output, and the tail
+// answered to the host covers all of it
+void tail_covers_output()
+{
+  vintage::test_host skipping{entry<Skipping>, 44100., 16};
+  vintage::test_host reference{entry<Oversampled>, 44100., 16};
+
+  const int32_t latency = skipping.effect->initialDelay;
+  const intptr_t tail
+      = skipping.dispatch(vintage::EffectOpcodes::GetTailSize);
+  VINTAGE_CHECK(latency > 1);
+  VINTAGE_CHECK(tail >= latency);
+  VINTAGE_CHECK(reference.dispatch(vintage::EffectOpcodes::GetTailSize) == 0);
+
+  const auto out = impulse_response(skipping);
+  VINTAGE_CHECK(out == impulse_response(reference));
+  for (std::size_t i = 64 + tail; i < out.size(); i++)
+    VINTAGE_CHECK(out[i] == 0.);
+}
+}
+
+int main()
+{
+  tail_covers_output();
+  return vintage::test::result();
+}
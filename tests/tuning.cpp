@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/test_host.hpp>
+#include <vintage/tuning.hpp>
+
+#include <cmath>
+
+namespace
+{
+bool near(double a, double b)
+{
+  return std::abs(a - b) <= 1e-4 * b;
+}
+
+// 12-tone equal temperament, with a 2/1 period given as a ratio
+constexpr const char* edo12 = R"(! 12edo.scl
+!
+12 tone equal temperament
+ 12
+!
+ 100.0
+ 200.0
+ 300.0
+ 400.0
+ 500.0
+ 600.0
+ 700.0
+ 800.0
+ 900.0
+ 1000.0
+ 1100.0
+ 2/1
+)";
+
+// C major on the white keys of each octave, the black keys unmapped;
+// notes outside [48; 84] are unmapped too
+constexpr const char* white_keys = R"(! white.kbm
+12
+48
+84
+60
+60
+261.6255653
+12
+0
+x
+2
+x
+4
+5
+x
+7
+x
+9
+x
+11
+)";
+
+void linear_mapping()
+{
+  // Size 0: linear mapping, with A4 at 440 Hz as the reference
+  constexpr const char* kbm = R"(! linear.kbm
+0
+0
+127
+60
+69
+440.0
+0
+! no mapping lines
+)";
+
+  vintage::tuning t;
+  VINTAGE_CHECK(t.load_scala(edo12, kbm));
+  for (int n = 0; n < 128; n++)
+    VINTAGE_CHECK(near(t.frequency[n], 440. * std::exp2((n - 69) / 12.)));
+}
+
+void white_keys_mapping()
+{
+  vintage::tuning t;
+  VINTAGE_CHECK(t.load_scala(edo12, white_keys));
+  const bool black[12]{0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0};
+  for (int n = 0; n < 128; n++)
+  {
+    if (n < 48 || n > 84 || black[n % 12])
+      VINTAGE_CHECK(t.frequency[n] == 0.f);
+    else
+      VINTAGE_CHECK(near(t.frequency[n], 440. * std::exp2((n - 69) / 12.)));
+  }
+}
+
+// Synths start no voice for unmapped keys
+void unmapped_keys_are_silent()
+{
+  using synth = vintage::PolyphonicSynthesizer<vintage::test::constant_synth>;
+  vintage::test_host host{
+      vintage::test::entry<vintage::test::constant_synth>, 44100., 64};
+  auto& s = *static_cast<synth*>(host.effect);
+  VINTAGE_CHECK(s.tuning.load_scala(edo12, white_keys));
+
+  host.note_on(0, 61, 100); // Black key
+  host.note_on(0, 40, 100); // Below the mapped range
+  host.render(64);
+  VINTAGE_CHECK(s.voices.empty());
+
+  host.note_on(0, 60, 100);
+  host.render(64);
+  VINTAGE_CHECK(!s.voices.empty());
+}
+
+void rejected_files()
+{
+  vintage::tuning t;
+  const float a4 = t.frequency[69];
+
+  // Fewer mapping lines than announced
+  VINTAGE_CHECK(!t.load_scala(edo12, "3\n0\n127\n60\n69\n440\n12\n0\n1\n"));
+  // Truncated header
+  VINTAGE_CHECK(!t.load_scala(edo12, "0\n0\n127\n60\n"));
+  // Fewer pitches than announced
+  VINTAGE_CHECK(!t.load_scala("short\n3\n100.0\n2/1\n"));
+  VINTAGE_CHECK(t.frequency[69] == a4);
+}
+}
+
+int main()
+{
+  linear_mapping();
+  white_keys_mapping();
+  unmapped_keys_are_silent();
+  rejected_files();
+  return vintage::test::result();
+}
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "check.hpp"
+
+#include <vintage/dsp/wavetable.hpp>
+
+#include <cmath>
+
+namespace
+{
+using namespace vintage::dsp;
+
+constexpr double pi = 3.141592653589793238462643383279502884;
+
+// Small enough for a naive DFT
+using small_table = wavetable<256, 8>;
+
+int32_t harmonics(int32_t level)
+{
+  return (small_table::size / 2) >> level;
+}
+
+// Magnitude of a harmonic in a level of the table
+double magnitude(const small_table& t, int32_t level, int32_t h)
+{
+  double re = 0., im = 0.;
+  for (int32_t i = 0; i < small_table::size; i++)
+  {
+    const double x = t.read(level, i, 0.f);
+    re += x * std::cos(2. * pi * h * i / small_table::size);
+    im += x * std::sin(2. * pi * h * i / small_table::size);
+  }
+  return 2. * std::hypot(re, im) / small_table::size;
+}
+
+// Each level holds the harmonics up to its limit and none above. Sampled, a
+// harmonic at Nyquist vanishes: the last one of level 0 cannot show.
+void band_limits()
+{
+  small_table t;
+  t.build(waveform::saw);
+  for (int32_t level = 1; level < small_table::levels; level++)
+  {
+    const int32_t last = harmonics(level);
+    const double amplitude = 2. / (pi * last);
+    VINTAGE_CHECK(std::abs(magnitude(t, level, last) - amplitude) < 1e-5);
+    for (int32_t h = last + 1; h < small_table::size / 2; h++)
+      VINTAGE_CHECK(magnitude(t, level, h) < 1e-5);
+  }
+}
+
+// The level chosen for an increment keeps its highest harmonic up to
+// Nyquist, and is the one with the most harmonics which does
+void mip_selection()
+{
+  small_table t;
+  for (double inc = 1e-5; inc <= 0.5; inc *= 1.001)
+  {
+    const int32_t level = t.level_for(float(inc));
+    VINTAGE_CHECK(level >= 0 && level < small_table::levels);
+    VINTAGE_CHECK(harmonics(level) * float(inc) <= 0.5f);
+    if (level > 0)
+      VINTAGE_CHECK(harmonics(level - 1) * float(inc) > 0.5f);
+  }
+
+  // Exactly on the boundaries
+  for (int32_t level = 0; level < small_table::levels; level++)
+    VINTAGE_CHECK(t.level_for(0.5f / harmonics(level)) == level);
+}
+
+// Phase of the oscillator after n samples, from the integer increment
+double expected_phase(uint32_t increment, int64_t n)
+{
+  return double(uint32_t(uint64_t(increment) * uint64_t(n))) / 4294967296.;
+}
+
+// The phase accumulates in fixed point and wraps by overflow: the output
+// follows the exact phase however long the note lasts
+void fixed_point_phase()
+{
+  const auto& sine = shared_wavetable<waveform::sine>();
+  wavetable_oscillator<> osc{.table = &sine};
+  osc.set_frequency(440.f, 48000.f);
+  VINTAGE_CHECK(osc.increment == uint32_t(440. / 48000. * 4294967296. + 0.5));
+  VINTAGE_CHECK(osc.level == sine.level_for(440.f / 48000.f));
+
+  // An hour into the note, across a few hundred wraps of the phase
+  const int64_t start = int64_t(3600) * 48000;
+  osc.phase = uint32_t(uint64_t(osc.increment) * uint64_t(start));
+  for (int64_t n = start; n < start + 4800; n++)
+  {
+    const double phase = expected_phase(osc.increment, n);
+    const double expected = std::sin(2. * pi * phase);
+    VINTAGE_CHECK(std::abs(osc.process() - expected) < 2e-6);
+  }
+
+  // Wrapping lands on the first sample of the table
+  osc.increment = 1u << 20;
+  osc.phase = -osc.increment;
+  osc.process();
+  VINTAGE_CHECK(osc.phase == 0);
+  VINTAGE_CHECK(osc.process() == 0.f);
+}
+
+// Increments are clamped between 0 and Nyquist
+void frequency_range()
+{
+  const auto& saw = shared_wavetable<waveform::saw>();
+  wavetable_oscillator<> osc{.table = &saw};
+  osc.set_frequency(30000.f, 48000.f);
+  VINTAGE_CHECK(osc.increment == 1u << 31);
+  VINTAGE_CHECK(osc.level == saw.levels - 1);
+
+  osc.set_frequency(0.f, 48000.f);
+  VINTAGE_CHECK(osc.increment == 0);
+  VINTAGE_CHECK(osc.level == 0);
+}
+}
+
+int main()
+{
+  band_limits();
+  mip_selection();
+  fixed_point_phase();
+  frequency_range();
+  return vintage::test::result();
+}
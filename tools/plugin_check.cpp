@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/instrumentation.hpp>
+#include <vintage/test_host.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Runs a plug-in headlessly through its lifecycle: a chord for synths, a
+// sine for effects, with a sweep of every parameter. Fails when the plug-in
+// cannot be loaded or outputs non-finite samples.
+//
+//   vintage_plugin_check <plugin> [--double] [--block <frames>]
+//                        [--seconds <s>] [--reference <file>]
+//                        [--save-reference <file>]
+//
+// A reference file holds the peak and RMS level of a previous run, e.g.
+// "peak 0.5\nrms 0.25\n". With --reference, the check also fails when the
+// levels drift from it by more than 0.1%, which the rounding differences
+// between precisions, compilers and SIMD widths stay well below.
+namespace
+{
+struct levels
+{
+  double peak{};
+  double rms{};
+};
+
+bool read_reference(const char* path, levels& out)
+{
+  std::FILE* f = std::fopen(path, "r");
+  if (!f)
+    return false;
+  const bool ok
+      = std::fscanf(f, " peak %lf rms %lf", &out.peak, &out.rms) == 2;
+  std::fclose(f);
+  return ok;
+}
+
+bool write_reference(const char* path, const levels& in)
+{
+  std::FILE* f = std::fopen(path, "w");
+  if (!f)
+    return false;
+  std::fprintf(f, "peak %.9g\nrms %.9g\n", in.peak, in.rms);
+  return std::fclose(f) == 0;
+}
+
+bool matches(double value, double reference) noexcept
+{
+  return std::abs(value - reference) <= 1e-3 * std::abs(reference) + 1e-9;
+}
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::fprintf(
+        stderr,
+        "usage: %s <plugin> [--double] [--block <frames>] [--seconds <s>]\n"
+        "       [--reference <file>] [--save-reference <file>]\n",
+        argv[0]);
+    return 2;
+  }
+
+  bool use_double = false;
+  int32_t block_size = 512;
+  double seconds = 2.;
+  const char* reference = nullptr;
+  const char* save_reference = nullptr;
+  for (int i = 2; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--double") == 0)
+      use_double = true;
+    else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+      block_size = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+      seconds = std::atof(argv[++i]);
+    else if (std::strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+      reference = argv[++i];
+    else if (std::strcmp(argv[i], "--save-reference") == 0 && i + 1 < argc)
+      save_reference = argv[++i];
+  }
+
+  vintage::plugin_library library{argv[1]};
+  if (!library.entry())
+  {
+    std::fprintf(stderr, "%s: cannot load VSTPluginMain\n", argv[1]);
+    return 1;
+  }
+
+  constexpr double sample_rate = 48000.;
+  vintage::test_host host{library.entry(), sample_rate, block_size};
+  if (!host)
+  {
+    std::fprintf(stderr, "%s: VSTPluginMain failed\n", argv[1]);
+    return 1;
+  }
+  if (use_double)
+    host.precision = vintage::ProcessPrecision::Double;
+
+  const auto& effect = *host.effect;
+  const int64_t frames = int64_t(seconds * sample_rate);
+  const bool synth = (static_cast<int32_t>(effect.flags)
+                      & static_cast<int32_t>(vintage::EffectFlags::IsSynth))
+                     != 0;
+
+  if (synth)
+  {
+    for (int32_t note : {48, 52, 55, 60})
+    {
+      host.note_on(0, note, 100);
+      host.note_off(frames * 3 / 4, note);
+    }
+  }
+  else
+  {
+    std::vector<double> sine(frames);
+    for (int64_t i = 0; i < frames; i++)
+      sine[i] = 0.5 * std::sin(2. * 3.14159265358979 * 440. * i / sample_rate);
+    for (int32_t c = 0; c < effect.numInputs; c++)
+      host.input(c, sine);
+  }
+
+  // Each parameter starts halfway, then goes through its range, one after
+  // the other
+  for (int32_t p = 0; p < effect.numParams; p++)
+    host.effect->setParameter(host.effect, p, 0.5f);
+  for (int32_t p = 0; p < effect.numParams; p++)
+    for (int32_t k = 0; k <= 8; k++)
+      host.automate(
+          frames * (p * 8 + k) / (effect.numParams * 8 + 1), p, k / 8.f);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  host.render(frames);
+  const auto t1 = std::chrono::steady_clock::now();
+
+  int64_t non_finite = 0;
+  double peak = 0., energy = 0.;
+  for (int32_t c = 0; c < effect.numOutputs; c++)
+    for (double x : host.captured(c))
+    {
+      if (!std::isfinite(x))
+      {
+        non_finite++;
+        continue;
+      }
+      peak = std::max(peak, std::abs(x));
+      energy += x * x;
+    }
+
+  const double elapsed = std::chrono::duration<double>(t1 - t0).count();
+  const double rms = std::sqrt(
+      energy / std::max<int64_t>(1, frames * effect.numOutputs));
+  std::printf(
+      "%s: %d in, %d out, %d params, latency %d, %s\n"
+      "peak %.6f, rms %.6f, %lld non-finite samples, "
+      "%.1fx real-time\n",
+      argv[1],
+      effect.numInputs,
+      effect.numOutputs,
+      effect.numParams,
+      effect.initialDelay,
+      synth ? "synth" : "effect",
+      peak,
+      rms,
+      (long long)non_finite,
+      seconds / std::max(elapsed, 1e-9));
+
+  // Plug-ins built with VINTAGE_INSTRUMENTATION time their process calls.
+  // Others may answer VendorSpecific with anything: only the magic as the
+  // return value tells that the block pointer was filled.
+  vintage::instrumentation_block* block = nullptr;
+  const intptr_t answer = host.dispatch(
+      vintage::EffectOpcodes::VendorSpecific,
+      vintage::instrumentation_block::magic,
+      0,
+      &block);
+  if (answer == vintage::instrumentation_block::magic && block
+      && block->layout == vintage::instrumentation_block::version)
+  {
+    using snapshot = vintage::instrumentation_snapshot;
+    const snapshot s = snapshot::read(*block);
+    std::printf(
+        "%llu process calls: p50 < %llu ns, p99 < %llu ns, max %llu ns, "
+        "%llu overruns\n",
+        (unsigned long long)s.calls,
+        (unsigned long long)s.percentile(0.5),
+        (unsigned long long)s.percentile(0.99),
+        (unsigned long long)s.max_ns,
+        (unsigned long long)s.overruns);
+  }
+
+  if (non_finite > 0)
+    return 1;
+
+  const levels measured{.peak = peak, .rms = rms};
+  if (save_reference && !write_reference(save_reference, measured))
+  {
+    std::fprintf(stderr, "%s: cannot write\n", save_reference);
+    return 1;
+  }
+  if (reference)
+  {
+    levels expected;
+    if (!read_reference(reference, expected))
+    {
+      std::fprintf(stderr, "%s: cannot read\n", reference);
+      return 1;
+    }
+    if (!matches(peak, expected.peak) || !matches(rms, expected.rms))
+    {
+      std::fprintf(
+          stderr,
+          "%s: expected peak %.6f, rms %.6f\n",
+          reference,
+          expected.peak,
+          expected.rms);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,401 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include "midi_file.hpp"
+#include "wav.hpp"
+
+#include <vintage/test_host.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Renders files through a plug-in, faster than real-time.
+//
+// Each input is a WAV file streamed through an effect, or a MIDI file played
+// into a synth. The files are processed concurrently, by workers which each
+// own an instance of the plug-in.
+namespace
+{
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+struct options
+{
+  const char* plugin{};
+  std::vector<std::string> inputs;
+  std::string output_directory;
+  std::string midi;
+  std::vector<std::pair<int32_t, float>> parameters;
+  int32_t block_size{4096};
+  int32_t jobs{};
+  int32_t sample_rate{48000};
+  double tail{-1.};
+  bool use_double{};
+};
+
+struct job
+{
+  std::string input;
+  std::string output;
+};
+
+struct outcome
+{
+  bool ok{};
+  std::string message;
+  double audio_seconds{};
+  double wall_seconds{};
+};
+
+void usage(const char* self)
+{
+  std::fprintf(
+      stderr,
+      "usage: %s <plugin> [options] <file.wav|file.mid>...\n"
+      "  -o <directory>     where the renders go (default: next to the\n"
+      "                     inputs, as <name>.render.wav)\n"
+      "  --midi <file.mid>  MIDI file played along each WAV file\n"
+      "  --jobs <n>         worker threads (default: one per core)\n"
+      "  --block <frames>   block size (default: 4096)\n"
+      "  --rate <hz>        sample rate of MIDI-only renders (default: "
+      "48000)\n"
+      "  --tail <seconds>   rendered past the end of the inputs (default:\n"
+      "                     the tail of the plug-in, or 2 s after MIDI)\n"
+      "  --param <i>=<v>    sets parameter i to v in [0; 1]\n"
+      "  --double           double-precision processing\n",
+      self);
+}
+
+bool parse(int argc, char** argv, options& opts)
+{
+  if (argc < 3)
+    return false;
+  opts.plugin = argv[1];
+  for (int i = 2; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(arg, "-o") == 0 && has_value)
+      opts.output_directory = argv[++i];
+    else if (std::strcmp(arg, "--midi") == 0 && has_value)
+      opts.midi = argv[++i];
+    else if (std::strcmp(arg, "--jobs") == 0 && has_value)
+      opts.jobs = std::atoi(argv[++i]);
+    else if (std::strcmp(arg, "--block") == 0 && has_value)
+      opts.block_size = std::atoi(argv[++i]);
+    else if (std::strcmp(arg, "--rate") == 0 && has_value)
+      opts.sample_rate = std::atoi(argv[++i]);
+    else if (std::strcmp(arg, "--tail") == 0 && has_value)
+      opts.tail = std::atof(argv[++i]);
+    else if (std::strcmp(arg, "--param") == 0 && has_value)
+    {
+      const char* value = argv[++i];
+      const char* eq = std::strchr(value, '=');
+      if (!eq)
+        return false;
+      opts.parameters.emplace_back(std::atoi(value), std::atof(eq + 1));
+    }
+    else if (std::strcmp(arg, "--double") == 0)
+      opts.use_double = true;
+    else if (arg[0] == '-')
+      return false;
+    else
+      opts.inputs.emplace_back(arg);
+  }
+  return !opts.inputs.empty() && opts.block_size > 0 && opts.sample_rate > 0;
+}
+
+bool is_midi(const fs::path& path)
+{
+  const auto ext = path.extension();
+  return ext == ".mid" || ext == ".midi" || ext == ".MID";
+}
+
+// Renders one file with the instance of a worker, in blocks of block_size
+template <typename sample_t>
+struct renderer
+{
+  renderer(vintage::test_host& host, const options& opts)
+      : host{host}
+      , opts{opts}
+  {
+    const int32_t ins = host.effect->numInputs;
+    const int32_t outs = host.effect->numOutputs;
+    const std::size_t block = opts.block_size;
+    buffers.resize((ins + outs) * block);
+    for (int32_t c = 0; c < ins; c++)
+      inputs.push_back(buffers.data() + c * block);
+    for (int32_t c = 0; c < outs; c++)
+      outputs.push_back(buffers.data() + (ins + c) * block);
+  }
+
+  outcome run(const job& j, const vintage::render::midi_file* shared_midi)
+  {
+    vintage::render::wav_reader wav;
+    vintage::render::midi_file own_midi;
+    const vintage::render::midi_file* midi = shared_midi;
+    int32_t rate = opts.sample_rate;
+    int64_t input_frames = 0;
+
+    if (is_midi(j.input))
+    {
+      if (!own_midi.open(j.input.c_str()))
+        return {.message = "cannot read the MIDI file"};
+      midi = &own_midi;
+    }
+    else
+    {
+      if (!wav.open(j.input.c_str()))
+        return {.message = "cannot read the WAV file, or unknown format"};
+      rate = wav.sample_rate;
+      input_frames = wav.frames;
+    }
+
+    // Settings, then the parameters, before processing resumes
+    host.rewind();
+    host.sample_rate = rate;
+    vintage::Effect& effect = *host.effect;
+    for (auto [index, value] : opts.parameters)
+      if (index >= 0 && index < effect.numParams)
+        effect.setParameter(&effect, index, value);
+    host.start();
+
+    int64_t midi_frames = 0;
+    if (midi)
+    {
+      for (const auto& m : midi->messages)
+      {
+        const int64_t frame = std::llround(m.time * rate);
+        host.midi(frame, m.bytes[0], m.bytes[1], m.bytes[2]);
+      }
+      midi_frames = std::llround(midi->duration() * rate);
+    }
+
+    const int64_t latency = effect.initialDelay;
+    const int64_t frames = std::max(input_frames, midi_frames)
+                           + tail_frames(rate, midi, latency);
+
+    vintage::render::wav_writer writer;
+    if (!writer.open(j.output.c_str(), effect.numOutputs, rate))
+      return {.message = "cannot write " + j.output};
+
+    const auto t0 = clock_type::now();
+    int64_t skip = latency;
+    for (int64_t pos = 0; pos < frames;)
+    {
+      const int32_t n
+          = int32_t(std::min<int64_t>(frames - pos, opts.block_size));
+      read_inputs(wav, pos, n);
+      host.process(inputs.data(), outputs.data(), n);
+
+      // The first frames only hold the latency of the plug-in
+      const int32_t dropped = int32_t(std::min<int64_t>(skip, n));
+      skip -= dropped;
+      if (dropped < n)
+      {
+        for (std::size_t c = 0; c < outputs.size(); c++)
+          shifted[c] = outputs[c] + dropped;
+        if (!writer.write(shifted.data(), n - dropped))
+          return {.message = "cannot write " + j.output};
+      }
+      pos += n;
+    }
+    if (!writer.close())
+      return {.message = "cannot write " + j.output};
+
+    const std::chrono::duration<double> dt = clock_type::now() - t0;
+    return {
+        .ok = true,
+        .message = {},
+        .audio_seconds = double(frames - latency) / rate,
+        .wall_seconds = dt.count()};
+  }
+
+  // Frames processed past the end of the inputs, latency included
+  int64_t tail_frames(
+      int32_t rate,
+      const vintage::render::midi_file* midi,
+      int64_t latency)
+  {
+    if (opts.tail >= 0.)
+      return std::llround(opts.tail * rate) + latency;
+
+    // 1 means no tail, 0 that the plug-in does not tell; the tail of vintage
+    // plug-ins counts their latency
+    const intptr_t tail = host.dispatch(vintage::EffectOpcodes::GetTailSize);
+    if (tail > 1)
+      return std::max<int64_t>(tail, latency);
+    return (midi ? 2 * rate : 0) + latency;
+  }
+
+  // Channels of the file are repeated if the plug-in has more inputs
+  void read_inputs(
+      const vintage::render::wav_reader& wav,
+      int64_t pos,
+      int32_t n)
+  {
+    const int64_t available
+        = std::clamp<int64_t>(wav.frames - pos, 0, int64_t(n));
+    for (std::size_t c = 0; c < inputs.size(); c++)
+    {
+      if (available > 0)
+        wav.read(
+            int32_t(c % wav.channels), pos, int32_t(available), inputs[c]);
+      std::fill(inputs[c] + available, inputs[c] + n, sample_t(0));
+    }
+  }
+
+  vintage::test_host& host;
+  const options& opts;
+  std::vector<sample_t> buffers;
+  std::vector<sample_t*> inputs, outputs;
+  std::vector<const sample_t*> shifted = std::vector<const sample_t*>(
+      host.effect->numOutputs);
+};
+
+template <typename sample_t>
+void work(
+    vintage::plugin_entry entry,
+    const options& opts,
+    const std::vector<job>& jobs,
+    const vintage::render::midi_file* midi,
+    std::atomic<std::size_t>& next,
+    std::vector<outcome>& outcomes,
+    std::mutex& print)
+{
+  vintage::test_host host{entry, double(opts.sample_rate), opts.block_size};
+  if (!host)
+  {
+    // The other workers still take the files
+    std::lock_guard lock{print};
+    std::fprintf(
+        stderr, "%s: VSTPluginMain failed, one worker less\n", opts.plugin);
+    return;
+  }
+  host.capture = false;
+  if constexpr (std::is_same_v<sample_t, double>)
+    host.precision = vintage::ProcessPrecision::Double;
+
+  renderer<sample_t> r{host, opts};
+  for (std::size_t i = next++; i < jobs.size(); i = next++)
+  {
+    outcomes[i] = r.run(jobs[i], midi);
+
+    std::lock_guard lock{print};
+    const outcome& o = outcomes[i];
+    if (o.ok)
+      std::printf(
+          "%s -> %s: %.1f s in %.2f s, %.1fx real-time\n",
+          jobs[i].input.c_str(),
+          jobs[i].output.c_str(),
+          o.audio_seconds,
+          o.wall_seconds,
+          o.audio_seconds / std::max(o.wall_seconds, 1e-9));
+    else
+      std::fprintf(
+          stderr, "%s: %s\n", jobs[i].input.c_str(), o.message.c_str());
+  }
+}
+}
+
+int main(int argc, char** argv)
+{
+  options opts;
+  if (!parse(argc, argv, opts))
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  vintage::plugin_library library{opts.plugin};
+  const vintage::plugin_entry entry = library.entry();
+  if (!entry)
+  {
+    std::fprintf(stderr, "%s: cannot load VSTPluginMain\n", opts.plugin);
+    return 1;
+  }
+
+  vintage::render::midi_file midi;
+  if (!opts.midi.empty() && !midi.open(opts.midi.c_str()))
+  {
+    std::fprintf(stderr, "%s: cannot read the MIDI file\n", opts.midi.c_str());
+    return 1;
+  }
+
+  if (!opts.output_directory.empty())
+  {
+    std::error_code ec;
+    fs::create_directories(opts.output_directory, ec);
+  }
+
+  std::vector<job> jobs;
+  for (const auto& input : opts.inputs)
+  {
+    const fs::path in{input};
+    const fs::path dir = opts.output_directory.empty()
+                             ? in.parent_path()
+                             : fs::path{opts.output_directory};
+    const std::string suffix
+        = opts.output_directory.empty() ? ".render.wav" : ".wav";
+    jobs.push_back({input, (dir / in.stem()).string() + suffix});
+  }
+
+  int32_t workers = opts.jobs > 0
+                        ? opts.jobs
+                        : int32_t(std::thread::hardware_concurrency());
+  workers = std::clamp<int32_t>(workers, 1, int32_t(jobs.size()));
+
+  std::atomic<std::size_t> next{0};
+  std::vector<outcome> outcomes(jobs.size());
+  std::mutex print;
+  const vintage::render::midi_file* shared_midi
+      = opts.midi.empty() ? nullptr : &midi;
+
+  const auto t0 = clock_type::now();
+  {
+    std::vector<std::jthread> threads;
+    for (int32_t w = 0; w < workers; w++)
+      threads.emplace_back(
+          [&]
+          {
+            if (opts.use_double)
+              work<double>(
+                  entry, opts, jobs, shared_midi, next, outcomes, print);
+            else
+              work<float>(
+                  entry, opts, jobs, shared_midi, next, outcomes, print);
+          });
+  }
+  const std::chrono::duration<double> elapsed = clock_type::now() - t0;
+
+  double audio = 0.;
+  int32_t failed = 0;
+  for (std::size_t i = 0; i < jobs.size(); i++)
+  {
+    const outcome& o = outcomes[i];
+    audio += o.audio_seconds;
+    failed += !o.ok;
+
+    // Left over when no instance of the plug-in could be created
+    if (!o.ok && o.message.empty())
+      std::fprintf(stderr, "%s: not rendered\n", jobs[i].input.c_str());
+  }
+
+  std::printf(
+      "%zu files, %.1f s of audio in %.2f s with %d workers: "
+      "%.1fx real-time\n",
+      jobs.size(),
+      audio,
+      elapsed.count(),
+      workers,
+      audio / std::max(elapsed.count(), 1e-9));
+  return failed == 0 ? 0 : 1;
+}
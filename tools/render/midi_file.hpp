@@ -0,0 +1,190 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/mapped_file.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include <vector>
+
+namespace vintage::render
+{
+
+// Channel messages of a standard MIDI file (format 0 or 1), merged across
+// tracks and timed in seconds through the tempo map. System exclusive and
+// meta events other than tempo changes are dropped.
+struct midi_file
+{
+  struct message
+  {
+    double time{};
+    uint8_t bytes[3]{};
+  };
+
+  bool open(const char* path)
+  {
+    mapped_file file;
+    if (!file.open(path) || file.size() < 14)
+      return false;
+
+    const auto* p = reinterpret_cast<const uint8_t*>(file.data());
+    const uint8_t* const end = p + file.size();
+    if (std::memcmp(p, "MThd", 4) != 0)
+      return false;
+
+    const uint32_t header_size = be32(p + 4);
+    const int32_t tracks = be16(p + 10);
+    const int16_t division = int16_t(be16(p + 12));
+    if (division == 0)
+      return false;
+
+    std::vector<timed_event> events;
+    const uint8_t* chunk = p + 8 + header_size;
+    for (int32_t t = 0; t < tracks && chunk + 8 <= end; t++)
+    {
+      const uint32_t size = be32(chunk + 4);
+      const uint8_t* body = chunk + 8;
+      const uint8_t* body_end
+          = body + std::min<std::size_t>(size, std::size_t(end - body));
+      if (std::memcmp(chunk, "MTrk", 4) == 0)
+        read_track(body, body_end, events);
+      chunk = body_end;
+    }
+
+    // Tempo changes first at a given tick; otherwise the file order
+    std::stable_sort(
+        events.begin(),
+        events.end(),
+        [](const timed_event& a, const timed_event& b)
+        {
+          if (a.tick != b.tick)
+            return a.tick < b.tick;
+          return a.tempo > 0 && b.tempo == 0;
+        });
+
+    // In SMPTE timing the division holds frames per second and ticks per
+    // frame; otherwise ticks per quarter note
+    const bool smpte = division < 0;
+    const double smpte_tick
+        = smpte ? 1. / (-(division >> 8) * (division & 0xFF)) : 0.;
+    double seconds_per_tick = smpte ? smpte_tick : 0.5 / division;
+
+    messages.clear();
+    double time = 0.;
+    uint64_t tick = 0;
+    for (const timed_event& e : events)
+    {
+      time += (e.tick - tick) * seconds_per_tick;
+      tick = e.tick;
+      if (e.tempo > 0)
+      {
+        if (!smpte)
+          seconds_per_tick = e.tempo * 1e-6 / division;
+        continue;
+      }
+      message m{.time = time};
+      std::memcpy(m.bytes, e.bytes, 3);
+      messages.push_back(m);
+    }
+    return true;
+  }
+
+  // In seconds
+  double duration() const noexcept
+  {
+    return messages.empty() ? 0. : messages.back().time;
+  }
+
+  std::vector<message> messages;
+
+private:
+  struct timed_event
+  {
+    uint64_t tick{};
+    uint32_t tempo{};
+    uint8_t bytes[3]{};
+  };
+
+  static uint32_t be32(const uint8_t* p) noexcept
+  {
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16
+           | uint32_t(p[2]) << 8 | p[3];
+  }
+  static uint32_t be16(const uint8_t* p) noexcept
+  {
+    return uint32_t(p[0]) << 8 | p[1];
+  }
+
+  static uint32_t read_varlen(const uint8_t*& p, const uint8_t* end) noexcept
+  {
+    uint32_t value = 0;
+    for (int i = 0; i < 4 && p < end; i++)
+    {
+      const uint8_t b = *p++;
+      value = (value << 7) | (b & 0x7F);
+      if (!(b & 0x80))
+        break;
+    }
+    return value;
+  }
+
+  static void read_track(
+      const uint8_t* p,
+      const uint8_t* end,
+      std::vector<timed_event>& events)
+  {
+    uint64_t tick = 0;
+    uint8_t status = 0;
+    while (p < end)
+    {
+      tick += read_varlen(p, end);
+      if (p >= end)
+        break;
+
+      if (*p == 0xFF)
+      {
+        // Meta event: only the tempo matters
+        if (p + 2 > end)
+          break;
+        const uint8_t type = p[1];
+        p += 2;
+        const uint32_t length = read_varlen(p, end);
+        if (length > std::size_t(end - p) || type == 0x2F)
+          break;
+        if (type == 0x51 && length == 3)
+          events.push_back(
+              {.tick = tick,
+               .tempo = uint32_t(p[0]) << 16 | uint32_t(p[1]) << 8 | p[2]});
+        p += length;
+        continue;
+      }
+      if (*p == 0xF0 || *p == 0xF7)
+      {
+        p++;
+        const uint32_t length = read_varlen(p, end);
+        p += std::min<std::size_t>(length, std::size_t(end - p));
+        continue;
+      }
+
+      // Running status: the status byte may be omitted
+      if (*p & 0x80)
+        status = *p++;
+      if (!(status & 0x80) || status >= 0xF0)
+        break;
+
+      const int32_t data = (status & 0xE0) == 0xC0 ? 1 : 2;
+      if (p + data > end)
+        break;
+      timed_event e{.tick = tick};
+      e.bytes[0] = status;
+      e.bytes[1] = p[0];
+      e.bytes[2] = data == 2 ? p[1] : 0;
+      events.push_back(e);
+      p += data;
+    }
+  }
+};
+
+}
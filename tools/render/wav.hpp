@@ -0,0 +1,233 @@
+#pragma once
+
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/mapped_file.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace vintage::render
+{
+
+namespace detail
+{
+inline uint32_t read_u32(const char* p) noexcept
+{
+  const auto* b = reinterpret_cast<const unsigned char*>(p);
+  return b[0] | (b[1] << 8) | (b[2] << 16) | (uint32_t(b[3]) << 24);
+}
+
+inline uint16_t read_u16(const char* p) noexcept
+{
+  const auto* b = reinterpret_cast<const unsigned char*>(p);
+  return uint16_t(b[0] | (b[1] << 8));
+}
+
+inline void write_u32(char* p, uint32_t v) noexcept
+{
+  for (int i = 0; i < 4; i++)
+    p[i] = char(v >> (8 * i));
+}
+
+inline void write_u16(char* p, uint16_t v) noexcept
+{
+  p[0] = char(v);
+  p[1] = char(v >> 8);
+}
+}
+
+// A WAV file, memory-mapped: samples are decoded a block at a time, as they
+// are read, so that files of any length stream through the page cache.
+//
+// Reads 8, 16, 24 and 32-bit PCM and 32 and 64-bit float, in plain or
+// extensible format.
+struct wav_reader
+{
+  bool open(const char* path) noexcept
+  {
+    if (!file.open(path) || file.size() < 12)
+      return false;
+
+    const char* p = file.data();
+    if (std::memcmp(p, "RIFF", 4) != 0 || std::memcmp(p + 8, "WAVE", 4) != 0)
+      return false;
+
+    const char* const end = p + file.size();
+    const char* chunk = p + 12;
+    bool has_format = false;
+    while (chunk + 8 <= end)
+    {
+      const uint32_t size = detail::read_u32(chunk + 4);
+      const char* body = chunk + 8;
+      if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+      {
+        format = detail::read_u16(body);
+        channels = detail::read_u16(body + 2);
+        sample_rate = detail::read_u32(body + 4);
+        bits = detail::read_u16(body + 14);
+        // WAVE_FORMAT_EXTENSIBLE: the format is in the sub-format GUID
+        if (format == 0xFFFE && size >= 40)
+          format = detail::read_u16(body + 24);
+        has_format = true;
+      }
+      else if (std::memcmp(chunk, "data", 4) == 0 && has_format)
+      {
+        samples = body;
+        const std::size_t available = std::size_t(end - body);
+        bytes_per_frame = channels * (bits / 8);
+        if (bytes_per_frame == 0)
+          return false;
+        frames = int64_t(std::min<std::size_t>(size, available))
+                 / bytes_per_frame;
+        break;
+      }
+      chunk = body + size + (size & 1);
+    }
+
+    const bool pcm = format == 1 && (bits == 8 || bits == 16 || bits == 24
+                                     || bits == 32);
+    const bool ieee = format == 3 && (bits == 32 || bits == 64);
+    if (!samples || !(pcm || ieee))
+      return false;
+
+    file.sequential();
+    return true;
+  }
+
+  // Decodes channel c of frames [first, first + count) into out
+  template <typename sample_t>
+  void read(
+      int32_t c,
+      int64_t first,
+      int32_t count,
+      sample_t* out) const noexcept
+  {
+    const int32_t bytes = bits / 8;
+    const char* p = samples + first * bytes_per_frame + c * bytes;
+    for (int32_t i = 0; i < count; i++, p += bytes_per_frame)
+      out[i] = sample_t(decode(p));
+  }
+
+  double decode(const char* p) const noexcept
+  {
+    if (format == 3)
+    {
+      if (bits == 32)
+      {
+        float f;
+        std::memcpy(&f, p, 4);
+        return f;
+      }
+      double d;
+      std::memcpy(&d, p, 8);
+      return d;
+    }
+
+    const auto* b = reinterpret_cast<const unsigned char*>(p);
+    switch (bits)
+    {
+      case 8:
+        return (int32_t(b[0]) - 128) / 128.;
+      case 16:
+        return int16_t(detail::read_u16(p)) / 32768.;
+      case 24:
+        return int32_t(uint32_t(b[0]) << 8 | uint32_t(b[1]) << 16
+                       | uint32_t(b[2]) << 24)
+               / 2147483648.;
+      default:
+        return int32_t(detail::read_u32(p)) / 2147483648.;
+    }
+  }
+
+  mapped_file file;
+  const char* samples{};
+  int32_t format{};
+  int32_t channels{};
+  int32_t sample_rate{};
+  int32_t bits{};
+  int32_t bytes_per_frame{};
+  int64_t frames{};
+};
+
+// Writes 32-bit float WAV files a block at a time; the sizes in the header
+// are filled in by close().
+struct wav_writer
+{
+  wav_writer() = default;
+  wav_writer(const wav_writer&) = delete;
+  wav_writer& operator=(const wav_writer&) = delete;
+  ~wav_writer() { close(); }
+
+  bool open(const char* path, int32_t channels, int32_t sample_rate)
+  {
+    close();
+    file = std::fopen(path, "wb");
+    if (!file)
+      return false;
+    this->channels = channels;
+    frames = 0;
+
+    // Large writes: the blocks are written in one call each
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    char header[header_size]{};
+    std::memcpy(header, "RIFF", 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    detail::write_u32(header + 16, 16);
+    detail::write_u16(header + 20, 3);
+    detail::write_u16(header + 22, uint16_t(channels));
+    detail::write_u32(header + 24, sample_rate);
+    detail::write_u32(header + 28, sample_rate * channels * 4);
+    detail::write_u16(header + 32, uint16_t(channels * 4));
+    detail::write_u16(header + 34, 32);
+    std::memcpy(header + 36, "data", 4);
+    return std::fwrite(header, header_size, 1, file) == 1;
+  }
+
+  // Interleaves the planar buffers
+  template <typename sample_t>
+  bool write(const sample_t* const* buffers, int32_t count)
+  {
+    interleaved.resize(std::size_t(count) * channels);
+    for (int32_t c = 0; c < channels; c++)
+      for (int32_t i = 0; i < count; i++)
+        interleaved[i * channels + c] = float(buffers[c][i]);
+    frames += count;
+    const std::size_t n = interleaved.size();
+    return std::fwrite(interleaved.data(), sizeof(float), n, file) == n;
+  }
+
+  bool close()
+  {
+    if (!file)
+      return true;
+
+    // Saturates past 4 GiB, which most readers tolerate
+    const uint64_t data_bytes = uint64_t(frames) * channels * 4;
+    auto patch = [this](long offset, uint64_t value)
+    {
+      char bytes[4];
+      detail::write_u32(
+          bytes, uint32_t(std::min<uint64_t>(value, UINT32_MAX)));
+      return std::fseek(file, offset, SEEK_SET) == 0
+             && std::fwrite(bytes, 4, 1, file) == 1;
+    };
+    bool ok = patch(4, data_bytes + header_size - 8);
+    ok &= patch(40, data_bytes);
+    ok &= std::fclose(file) == 0;
+    file = nullptr;
+    return ok;
+  }
+
+  static constexpr int32_t header_size = 44;
+  std::FILE* file{};
+  int32_t channels{};
+  int64_t frames{};
+  std::vector<float> interleaved;
+};
+
+}
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: AGPL-3.0-or-later */
+
+#include <vintage/instrumentation.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Reads the statistics of a running plug-in instance built with
+// VINTAGE_INSTRUMENTATION and VINTAGE_INSTRUMENTATION_SHM, from its shared
+// memory segment: /dev/shm/vintage.<pid>.<instance> on Linux.
+//
+//   vintage-stats <segment> [--watch]
+namespace
+{
+void print(const vintage::instrumentation_block& block)
+{
+  using snapshot = vintage::instrumentation_snapshot;
+  const snapshot s = snapshot::read(block);
+
+  const double mean = s.calls ? double(s.total_ns) / s.calls : 0.;
+  const double load
+      = s.frames && s.sample_rate > 0.
+            ? s.total_ns * 1e-9 / (s.frames / s.sample_rate)
+            : 0.;
+  std::printf(
+      "%s: %llu calls, %llu frames at %.0f Hz, %.1f%% of real-time\n"
+      "  mean %.0f ns, p50 < %llu ns, p99 < %llu ns, p99.9 < %llu ns, "
+      "max %llu ns, %llu overruns\n",
+      block.name,
+      (unsigned long long)s.calls,
+      (unsigned long long)s.frames,
+      s.sample_rate,
+      100. * load,
+      mean,
+      (unsigned long long)s.percentile(0.5),
+      (unsigned long long)s.percentile(0.99),
+      (unsigned long long)s.percentile(0.999),
+      (unsigned long long)s.max_ns,
+      (unsigned long long)s.overruns);
+
+  snapshot::call calls[8];
+  const int32_t n = snapshot::recent(block, calls, 8);
+  for (int32_t i = 0; i < n; i++)
+    std::printf(
+        "  %8u ns  %5d frames  %4d voices\n",
+        calls[i].duration_ns,
+        calls[i].frames,
+        calls[i].voices);
+}
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    std::fprintf(stderr, "usage: %s <segment> [--watch]\n", argv[0]);
+    return 2;
+  }
+
+  const std::string_view arg = argv[1];
+  std::string name;
+  if (!arg.starts_with('/'))
+    name = "/";
+  name.append(arg);
+
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    std::fprintf(stderr, "%s: no such segment\n", name.c_str());
+    return 1;
+  }
+
+  // Reading past the end of a shorter segment would raise SIGBUS
+  struct stat st{};
+  if (fstat(fd, &st) != 0
+      || st.st_size < off_t(sizeof(vintage::instrumentation_block)))
+  {
+    ::close(fd);
+    std::fprintf(stderr, "%s: not a vintage segment\n", name.c_str());
+    return 1;
+  }
+  void* p = mmap(
+      nullptr,
+      sizeof(vintage::instrumentation_block),
+      PROT_READ,
+      MAP_SHARED,
+      fd,
+      0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+  {
+    std::fprintf(stderr, "%s: cannot map the segment\n", name.c_str());
+    return 1;
+  }
+
+  const auto& block = *static_cast<const vintage::instrumentation_block*>(p);
+  if (block.header != vintage::instrumentation_block::magic
+      || block.layout != vintage::instrumentation_block::version)
+  {
+    std::fprintf(stderr, "%s: not a vintage segment\n", name.c_str());
+    return 1;
+  }
+
+  const bool watch = argc > 2 && std::strcmp(argv[2], "--watch") == 0;
+  do
+  {
+    print(block);
+    if (watch)
+      std::this_thread::sleep_for(std::chrono::seconds(1));
+  } while (watch);
+
+  munmap(p, sizeof(vintage::instrumentation_block));
+}